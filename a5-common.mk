@@ -175,6 +175,12 @@ PRODUCT_COPY_FILES += \
     $(LOCAL_PATH)/gps/etc/izat.conf:system/etc/izat.conf \
     $(LOCAL_PATH)/gps/etc/sap.conf:system/etc/sap.conf
 
+PRODUCT_PACKAGES += \
+    flp.conf.bin \
+    gps.conf.bin \
+    izat.conf.bin \
+    sap.conf.bin
+
 # Graphics
 PRODUCT_PACKAGES += \
     android.hardware.graphics.allocator@2.0-impl \
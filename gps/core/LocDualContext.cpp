@@ -35,9 +35,37 @@
 #include <msg_q.h>
 #include <log_util.h>
 #include <loc_log.h>
+#include <loc_cfg.h>
+
+#ifndef GPS_CONF_FILE
+#define GPS_CONF_FILE            "/etc/gps.conf"
+#endif
 
 namespace loc_core {
 
+/* Loc_hal_worker MsgTask options, read from gps.conf */
+#define HAL_WORKER_MAX_THREADS 4
+static uint32_t HAL_WORKER_LOCK_FREE_Q = 0;
+static uint32_t HAL_WORKER_BATCH_DRAIN = 0;
+static uint32_t HAL_WORKER_Q_CAPACITY = 0;
+static uint32_t HAL_WORKER_Q_FULL_POLICY = eMSG_Q_FULL_BLOCK;
+static uint32_t HAL_WORKER_SUPERSEDE = 0;
+static uint32_t HAL_WORKER_HIGH_BURST = 8;
+static uint32_t HAL_WORKER_INSTRUMENT = 0;
+static uint32_t HAL_WORKER_THREADS = 1;
+
+static const loc_param_s_type hal_worker_conf_table[] =
+{
+    {"HAL_WORKER_LOCK_FREE_Q",    &HAL_WORKER_LOCK_FREE_Q,    NULL, 'n'},
+    {"HAL_WORKER_BATCH_DRAIN",    &HAL_WORKER_BATCH_DRAIN,    NULL, 'n'},
+    {"HAL_WORKER_Q_CAPACITY",     &HAL_WORKER_Q_CAPACITY,     NULL, 'n'},
+    {"HAL_WORKER_Q_FULL_POLICY",  &HAL_WORKER_Q_FULL_POLICY,  NULL, 'n'},
+    {"HAL_WORKER_SUPERSEDE",      &HAL_WORKER_SUPERSEDE,      NULL, 'n'},
+    {"HAL_WORKER_HIGH_BURST",     &HAL_WORKER_HIGH_BURST,     NULL, 'n'},
+    {"HAL_WORKER_INSTRUMENT",     &HAL_WORKER_INSTRUMENT,     NULL, 'n'},
+    {"HAL_WORKER_THREADS",        &HAL_WORKER_THREADS,        NULL, 'n'},
+};
+
 // nothing exclude for foreground
 const LOC_API_ADAPTER_EVENT_MASK_T
 LocDualContext::mFgExclMask = 0;
@@ -67,7 +95,26 @@ const MsgTask* LocDualContext::getMsgTask(LocThread::tCreate tCreator,
                                           const char* name, bool joinable)
 {
     if (NULL == mMsgTask) {
-        mMsgTask = new MsgTask(tCreator, name, joinable);
+        MsgTaskConfig config;
+        UTIL_READ_CONF(GPS_CONF_FILE, hal_worker_conf_table);
+        LocThreadProfile::setConfFile(GPS_CONF_FILE);
+        config.mLockFree = (0 != HAL_WORKER_LOCK_FREE_Q);
+        config.mBatchDrain = (0 != HAL_WORKER_BATCH_DRAIN);
+        config.mCapacity = HAL_WORKER_Q_CAPACITY;
+        config.mFullPolicy = (HAL_WORKER_Q_FULL_POLICY <= eMSG_Q_FULL_COALESCE) ?
+            (msg_q_full_policy_type)HAL_WORKER_Q_FULL_POLICY : eMSG_Q_FULL_BLOCK;
+        config.mSupersede = (0 != HAL_WORKER_SUPERSEDE);
+        config.mHighBurst = HAL_WORKER_HIGH_BURST;
+        config.mInstrument = (0 != HAL_WORKER_INSTRUMENT);
+        config.mWorkers = (HAL_WORKER_THREADS > HAL_WORKER_MAX_THREADS) ?
+            HAL_WORKER_MAX_THREADS : HAL_WORKER_THREADS;
+        LOC_LOGD("%s:%d]: %s queue: %s, batch drain: %d, capacity: %u, full policy: %d, "
+                 "supersede: %d, high burst: %u, instrument: %d, threads: %u",
+                 __func__, __LINE__, name,
+                 config.mLockFree ? "lock free" : "msg_q", config.mBatchDrain,
+                 config.mCapacity, config.mFullPolicy, config.mSupersede,
+                 config.mHighBurst, config.mInstrument, config.mWorkers);
+        mMsgTask = new MsgTask(tCreator, name, joinable, config);
     }
     return mMsgTask;
 }
@@ -0,0 +1,23 @@
+LOCAL_PATH := $(call my-dir)
+
+# Binary images of the config files, installed next to them as
+# /etc/<file>.bin, so the HAL applies its config tables without parsing
+# the text at startup. An image is only used while the text file it was
+# compiled from is unchanged, so a device that installs these config files
+# adds e.g. gps.conf.bin to PRODUCT_PACKAGES along with them.
+LOC_CFG_COMPILE := $(HOST_OUT_EXECUTABLES)/loc_cfg_compile$(HOST_EXECUTABLE_SUFFIX)
+
+define loc-cfg-image
+include $$(CLEAR_VARS)
+LOCAL_MODULE := $(1).bin
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_PATH := $$(TARGET_OUT_ETC)
+include $$(BUILD_SYSTEM)/base_rules.mk
+$$(LOCAL_BUILT_MODULE): PRIVATE_SRC := $$(LOCAL_PATH)/$(1)
+$$(LOCAL_BUILT_MODULE): $$(LOCAL_PATH)/$(1) $$(LOC_CFG_COMPILE)
+	@mkdir -p $$(dir $$@)
+	$$(hide) $$(LOC_CFG_COMPILE) $$(PRIVATE_SRC) $$@
+endef
+
+$(foreach conf,gps.conf sap.conf izat.conf flp.conf,$(eval $(call loc-cfg-image,$(conf))))
@@ -114,6 +114,21 @@ static const loc_param_s_type gps_conf_table[] =
   {"USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL",  &gps_conf.USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL,          NULL, 'n'},
 };
 
+/* gps.conf entries picked up while the HAL runs, the same ones that
+   loc_eng_configuration_update() takes from the framework. The watch
+   writes them here, on its own thread; loc_eng_conf_changed() hands each
+   changed one to the HAL worker, which copies it into gps_conf. */
+static loc_gps_cfg_s_type gps_conf_watched;
+static const loc_param_s_type gps_conf_watch_table[] =
+{
+  {"GPS_LOCK",                       &gps_conf_watched.GPS_LOCK,                       NULL, 'n'},
+  {"SUPL_VER",                       &gps_conf_watched.SUPL_VER,                       NULL, 'n'},
+  {"LPP_PROFILE",                    &gps_conf_watched.LPP_PROFILE,                    NULL, 'n'},
+  {"A_GLONASS_POS_PROTOCOL_SELECT",  &gps_conf_watched.A_GLONASS_POS_PROTOCOL_SELECT,  NULL, 'n'},
+  {"SUPL_MODE",                      &gps_conf_watched.SUPL_MODE,                      NULL, 'n'},
+  {"SUPL_ES",                        &gps_conf_watched.SUPL_ES,                        NULL, 'n'},
+};
+
 static const loc_param_s_type sap_conf_table[] =
 {
   {"GYRO_BIAS_RANDOM_WALK",          &sap_conf.GYRO_BIAS_RANDOM_WALK,          &sap_conf.GYRO_BIAS_RANDOM_WALK_VALID, 'f'},
@@ -211,6 +226,7 @@ static void deleteAidingData(loc_eng_data_s_type &logEng);
 static AgpsStateMachine*
 getAgpsStateMachine(loc_eng_data_s_type& logEng, AGpsExtType agpsType);
 static int dataCallCb(void *cb_data);
+static void loc_eng_conf_changed(const loc_param_s_type* config_entry, void* user_data);
 static void update_aiding_data_for_deletion(loc_eng_data_s_type& loc_eng_data) {
     if (loc_eng_data.engine_status != GPS_STATUS_ENGINE_ON &&
         loc_eng_data.aiding_data_for_deletion != 0)
@@ -285,7 +301,8 @@ void LocEngStartFix::send() const {
 
 //        case LOC_ENG_MSG_STOP_FIX:
 LocEngStopFix::LocEngStopFix(LocEngAdapter* adapter) :
-    LocMsg(), mAdapter(adapter)
+    LocMsg(), mAdapter(adapter),
+    mSentTimeMs(ELAPSED_MILLIS_SINCE_BOOT_PLATFORM_LIB_ABSTRACTION)
 {
     locallog();
 }
@@ -293,6 +310,15 @@ inline void LocEngStopFix::proc() const
 {
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)mAdapter->getOwner();
     loc_eng_stop_handler(*locEng);
+
+    // reports still pending are the ones yet to be delivered before quiet
+    msg_q_stats_type stats;
+    if (mAdapter->getContext()->getMsgTask()->getStats(stats)) {
+        LOC_LOGD("%s: stop latency %lld ms, %u msgs pending, %llu starvation yields",
+                 __func__,
+                 (long long)(ELAPSED_MILLIS_SINCE_BOOT_PLATFORM_LIB_ABSTRACTION - mSentTimeMs),
+                 stats.size, (unsigned long long)stats.starvation_yields);
+    }
 }
 inline void LocEngStopFix::locallog() const
 {
@@ -740,6 +766,15 @@ LocEngReportPosition::LocEngReportPosition(LocAdapterBase* adapter,
 {
     locallog();
 }
+LocEngReportPosition::~LocEngReportPosition() {
+    // proc() frees rawData once reported; free it here if this msg
+    // was muted, or dropped from a full queue without being proc()'ed
+    UlpLocation* gp = (UlpLocation*)&(mLocation);
+    if (gp->rawData != NULL) {
+        delete (char*)gp->rawData;
+        gp->rawData = NULL;
+    }
+}
 void LocEngReportPosition::proc() const {
     LocEngAdapter* adapter = (LocEngAdapter*)mAdapter;
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)adapter->getOwner();
@@ -1043,6 +1078,7 @@ struct LocEngReleaseBIT : public LocMsg {
     virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
 };
 
 //        LocEngSuplEsOpened
@@ -1442,6 +1478,7 @@ struct LocEngAtlOpenSuccess : public LocMsg {
     inline virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
 };
 
 //        case LOC_ENG_MSG_ATL_CLOSED:
@@ -1460,6 +1497,7 @@ struct LocEngAtlClosed : public LocMsg {
     inline virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
 };
 
 //        case LOC_ENG_MSG_ATL_OPEN_FAILED:
@@ -1478,6 +1516,7 @@ struct LocEngAtlOpenFailed : public LocMsg {
     inline virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
 };
 
 //        case LOC_ENG_MSG_ENGINE_DOWN:
@@ -1532,6 +1571,34 @@ struct LocEngDataClientInit : public LocMsg {
     virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
+};
+
+// drops the subscribers of, and reinits, the AGPS state machines once the
+// engine is back up. A msg of its own, so that it is serialized with the
+// other AGPS msgs rather than with the engine up one.
+struct LocEngAgpsReset : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    inline LocEngAgpsReset(loc_eng_data_s_type* locEng) :
+        LocMsg(), mLocEng(locEng) {
+        locallog();
+    }
+    virtual void proc() const {
+        if (mLocEng->agnss_nif)
+            mLocEng->agnss_nif->dropAllSubscribers();
+        if (mLocEng->internet_nif)
+            mLocEng->internet_nif->dropAllSubscribers();
+
+        loc_eng_agps_reinit(*mLocEng);
+    }
+    void locallog() const {
+        LOC_LOGV("LocEngAgpsReset\n");
+    }
+    virtual void log() const {
+        locallog();
+    }
+    inline virtual const char* name() const { return "LocEngAgpsReset"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
 };
 
 struct LocEngInstallAGpsCert : public LocMsg {
@@ -1777,6 +1844,10 @@ int loc_eng_init(loc_eng_data_s_type &loc_eng_data, LocCallbacks* callbacks,
              loc_eng_data.adapter);
     loc_eng_data.adapter->sendMsg(new LocEngInit(&loc_eng_data));
 
+    // pick up gps.conf edits without restarting the HAL
+    UTIL_READ_CONF(GPS_CONF_FILE, gps_conf_watch_table);
+    UTIL_WATCH_CONF(GPS_CONF_FILE, gps_conf_watch_table, loc_eng_conf_changed, &loc_eng_data);
+
     EXIT_LOG(%d, ret_val);
     return ret_val;
 }
@@ -1855,6 +1926,8 @@ void loc_eng_cleanup(loc_eng_data_s_type &loc_eng_data)
     ENTRY_LOG_CALLFLOW();
     INIT_CHECK(loc_eng_data.adapter, return);
 
+    loc_unwatch_conf(gps_conf_watch_table);
+
     // XTRA has no state, so we are fine with it.
 
     // we need to check and clear NI
@@ -2746,6 +2819,136 @@ void loc_eng_configuration_update (loc_eng_data_s_type &loc_eng_data,
     EXIT_LOG(%s, VOID_RET);
 }
 
+struct LocEngGpsConfReload : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    // entry of gps_conf_watch_table that changed, and its new value, as
+    // read on the watch thread
+    const loc_param_s_type* mEntry;
+    const uint32_t mValue;
+    inline LocEngGpsConfReload(loc_eng_data_s_type* locEng,
+                               const loc_param_s_type* entry) :
+        LocMsg(), mLocEng(locEng), mEntry(entry),
+        mValue(*(const uint32_t*)entry->param_ptr)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        LocEngAdapter* adapter = mLocEng->adapter;
+        // the same field of gps_conf as the entry's of gps_conf_watched
+        uint32_t* field = (uint32_t*)((char*)&gps_conf +
+                                      ((char*)mEntry->param_ptr - (char*)&gps_conf_watched));
+        if (*field == mValue) {
+            return;
+        }
+        *field = mValue;
+        if (field == &gps_conf.SUPL_VER) {
+            adapter->sendMsg(new LocEngSuplVer(adapter, gps_conf.SUPL_VER));
+        } else if (field == &gps_conf.LPP_PROFILE) {
+            adapter->sendMsg(new LocEngLppConfig(adapter, gps_conf.LPP_PROFILE));
+        } else if (field == &gps_conf.A_GLONASS_POS_PROTOCOL_SELECT) {
+            adapter->sendMsg(new LocEngAGlonassProtocol(adapter,
+                                                        gps_conf.A_GLONASS_POS_PROTOCOL_SELECT));
+        } else if (field == &gps_conf.SUPL_MODE) {
+            adapter->sendMsg(new LocEngSuplMode(adapter->getUlpProxy()));
+        }
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngGpsConfReload - %s: %d", mEntry->param_name, mValue);
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_conf_changed
+
+DESCRIPTION
+   Change callback of the gps.conf watch, called on the watch thread once
+   per entry of gps_conf_watched that changed. Only that entry's new value
+   is handed to the HAL worker, which copies it into gps_conf and sends it
+   to the modem if needed, the same way loc_eng_configuration_update()
+   does for framework updates. Other entries, which the framework may
+   have set since, are left alone.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_conf_changed(const loc_param_s_type* config_entry, void* user_data)
+{
+    loc_eng_data_s_type* loc_eng_data = (loc_eng_data_s_type*)user_data;
+    LocEngAdapter* adapter = loc_eng_data->adapter;
+
+    // it is possible that HAL is not init'ed at this time
+    if (NULL == adapter) {
+        return;
+    }
+
+    LOC_LOGD("%s: %s changed", __FUNCTION__, config_entry->param_name);
+    adapter->sendMsg(new LocEngGpsConfReload(loc_eng_data, config_entry));
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_session_msg_stats
+
+DESCRIPTION
+   Snapshots the HAL worker msg_q counters at session begin, and logs how
+   many position / SV reports a newer report superseded or coalesced
+   during the session at session end. An instrumented HAL worker also
+   dumps its queue latency stats at session end.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_session_msg_stats(loc_eng_data_s_type &loc_eng_data,
+                                      GpsStatusValue status)
+{
+    const MsgTask* msgTask = loc_eng_data.adapter->getContext()->getMsgTask();
+    if (status == GPS_STATUS_SESSION_END)
+    {
+        msgTask->dumpStats();
+    }
+
+    msg_q_stats_type stats;
+    if (!msgTask->getStats(stats))
+    {
+        return;
+    }
+
+    if (status == GPS_STATUS_SESSION_END)
+    {
+        LOC_LOGD("%s: session superseded %llu, coalesced %llu position / SV reports",
+                 __func__,
+                 (unsigned long long)(stats.superseded - loc_eng_data.session_superseded),
+                 (unsigned long long)(stats.coalesced - loc_eng_data.session_coalesced));
+
+        mem_pool_stats_type pos, sv;
+        if (LocEngReportPosition::getPoolStats(pos) && LocEngReportSv::getPoolStats(sv))
+        {
+            LOC_LOGD("%s: report pools hits / misses: position %llu / %llu, SV %llu / %llu",
+                     __func__,
+                     (unsigned long long)pos.hits, (unsigned long long)pos.misses,
+                     (unsigned long long)sv.hits, (unsigned long long)sv.misses);
+        }
+    }
+    loc_eng_data.session_superseded = stats.superseded;
+    loc_eng_data.session_coalesced = stats.coalesced;
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_report_status
 
@@ -2808,6 +3011,10 @@ static void loc_eng_report_status (loc_eng_data_s_type &loc_eng_data, GpsStatusV
     // Only keeps SESSION BEGIN/END in fix_session_status
     if (status == GPS_STATUS_SESSION_BEGIN || status == GPS_STATUS_SESSION_END)
     {
+        if (loc_eng_data.fix_session_status != status)
+        {
+            loc_eng_session_msg_stats(loc_eng_data, status);
+        }
         loc_eng_data.fix_session_status = status;
     }
     EXIT_LOG(%s, VOID_RET);
@@ -2848,12 +3055,7 @@ void loc_eng_handle_engine_up(loc_eng_data_s_type &loc_eng_data)
     loc_eng_data.adapter->requestPowerVote();
 
     if (loc_eng_data.agps_status_cb != NULL) {
-        if (loc_eng_data.agnss_nif)
-            loc_eng_data.agnss_nif->dropAllSubscribers();
-        if (loc_eng_data.internet_nif)
-            loc_eng_data.internet_nif->dropAllSubscribers();
-
-        loc_eng_agps_reinit(loc_eng_data);
+        loc_eng_data.adapter->sendMsg(new LocEngAgpsReset(&loc_eng_data));
     }
 
     // modem is back up.  If we crashed in the middle of navigating, we restart.
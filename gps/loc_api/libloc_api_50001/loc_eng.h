@@ -111,6 +111,11 @@ typedef struct loc_eng_data_s
     GpsStatusValue                 engine_status;
     GpsStatusValue                 fix_session_status;
 
+    // HAL worker msg_q counters at session begin, to tell how many reports
+    // were superseded / coalesced during a session
+    uint64_t                       session_superseded;
+    uint64_t                       session_coalesced;
+
     // Aiding data information to be deleted, aiding data can only be deleted when GPS engine is off
     GpsAidingData                  aiding_data_for_deletion;
 
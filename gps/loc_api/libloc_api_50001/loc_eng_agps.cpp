@@ -49,6 +49,14 @@ static void deleteObj(void* data)
     delete (Subscriber*)data;
 }
 
+// This is given to linked_list_init_hashed() as the hash callback.
+// Subscribers that equals() each other have the same ID.
+// data -- an instance of Subscriber
+static uint32_t hashSubscriber(void* data)
+{
+    return ((Subscriber*)data)->ID;
+}
+
 // This is given to linked_list_search() as the comparison callback
 // when the state manchine needs to process for particular subscriber
 // fromCaller -- caller provides this obj
@@ -631,7 +639,7 @@ AgpsStateMachine::AgpsStateMachine(servicerType servType,
     mEnforceSingleSubscriber(enforceSingleSubscriber),
     mServicer(Servicer :: getServicer(servType, (void *)cb_func))
 {
-    linked_list_init(&mSubscribers);
+    linked_list_init_hashed(&mSubscribers, hashSubscriber, SUBSCRIBER_BUCKETS);
 
     // setting up mReleasedState
     mStatePtr->mPendingState = new AgpsPendingState(this);
@@ -714,7 +722,16 @@ void AgpsStateMachine::onRsrcEvent(AgpsRsrcStatus event)
 
 void AgpsStateMachine::notifySubscribers(Notification& notification) const
 {
-    if (notification.postNotifyDelete) {
+    if (NULL != notification.rcver) {
+        // only the one subscriber equals() to rcver is interested, and
+        // there is at most one in the list, see addSubscriber()
+        Subscriber* s = NULL;
+        linked_list_search_hashed(mSubscribers,
+                                  notification.postNotifyDelete ? (void**)&s : NULL,
+                                  notification.rcver->ID, notifySubscriber,
+                                  (void*)&notification, notification.postNotifyDelete);
+        delete s;
+    } else if (notification.postNotifyDelete) {
         // just any non NULL value to get started
         Subscriber* s = (Subscriber*)~0;
         while (NULL != s) {
@@ -739,8 +756,8 @@ void AgpsStateMachine::addSubscriber(Subscriber* subscriber) const
 {
     Subscriber* s = NULL;
     Notification notification((const Subscriber*)subscriber);
-    linked_list_search(mSubscribers, (void**)&s,
-                       hasSubscriber, (void*)&notification, false);
+    linked_list_search_hashed(mSubscribers, (void**)&s, subscriber->ID,
+                              hasSubscriber, (void*)&notification, false);
 
     if (NULL == s) {
         linked_list_add(mSubscribers, subscriber->clone(), deleteObj);
@@ -790,8 +807,8 @@ bool AgpsStateMachine::unsubscribeRsrc(Subscriber *subscriber)
 {
     Subscriber* s = NULL;
     Notification notification((const Subscriber*)subscriber);
-    linked_list_search(mSubscribers, (void**)&s,
-                       hasSubscriber, (void*)&notification, false);
+    linked_list_search_hashed(mSubscribers, (void**)&s, subscriber->ID,
+                              hasSubscriber, (void*)&notification, false);
 
     if (NULL != s) {
         mStatePtr = mStatePtr->onRsrcEvent(RSRC_UNSUBSCRIBE, (void*)s);
@@ -179,8 +179,11 @@ public:
 
 class AgpsStateMachine {
 protected:
-    // a linked list of subscribers.
+    // a linked list of subscribers, hashed by Subscriber::ID, so that
+    // a particular subscriber is looked up in constant time.
     void* mSubscribers;
+    // size of the hashed index of mSubscribers
+    static const uint32_t SUBSCRIBER_BUCKETS = 8;
     //handle to whoever provides the service
     Servicer *mServicer;
     // allows AgpsState to access private data
@@ -38,6 +38,7 @@
 #include <loc_eng_log.h>
 #include <loc_eng.h>
 #include <MsgTask.h>
+#include <LocPooled.h>
 #include <LocEngAdapter.h>
 
 #ifndef SSID_BUF_SIZE
@@ -56,11 +57,32 @@ extern "C" {
 
 using namespace loc_core;
 
+// LocMsg::coalesceKey() of the msgs that a newer msg of the same kind
+// supersedes, when the HAL worker queue is full and configured to coalesce.
+// Only msgs with a key are ever dropped by the HAL worker queue.
+enum loc_eng_msg_coalesce_key {
+    LOC_ENG_MSG_KEY_NONE = 0,
+    LOC_ENG_MSG_KEY_POSITION,
+    LOC_ENG_MSG_KEY_SV
+};
+
+// LocMsg::serialKey() of the msgs. Msgs of the same key are handled in
+// order; with HAL_WORKER_THREADS > 1 in gps.conf, msgs of different keys
+// may be handled in parallel. AGPS and XTRA msgs only touch the AGPS
+// state machines and the XTRA data respectively; everything that touches
+// the engine or session state, reports included, stays on the control key.
+enum loc_eng_msg_serial_key {
+    LOC_ENG_SERIAL_CONTROL = 0,
+    LOC_ENG_SERIAL_AGPS,
+    LOC_ENG_SERIAL_XTRA
+};
+
 struct LocEngPositionMode : public LocMsg {
     LocEngAdapter* mAdapter;
     const LocPosMode mPosMode;
     LocEngPositionMode(LocEngAdapter* adapter, LocPosMode &mode);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngPositionMode"; }
     virtual void log() const;
     void send() const;
 };
@@ -70,6 +92,7 @@ struct LocEngStartFix : public LocMsg {
     LocEngAdapter* mAdapter;
     LocEngStartFix(LocEngAdapter* adapter);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngStartFix"; }
     void locallog() const;
     virtual void log() const;
     void send() const;
@@ -77,14 +100,19 @@ struct LocEngStartFix : public LocMsg {
 
 struct LocEngStopFix : public LocMsg {
     LocEngAdapter* mAdapter;
+    // when this msg was created, to measure stop latency
+    const int64_t mSentTimeMs;
     LocEngStopFix(LocEngAdapter* adapter);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngStopFix"; }
     void locallog() const;
     virtual void log() const;
     void send() const;
 };
 
-struct LocEngReportPosition : public LocMsg {
+// report msgs are new'ed per fix / per second, so they come from pools
+struct LocEngReportPosition : public LocMsg,
+                              public LocPooled<LocEngReportPosition, 8> {
     LocAdapterBase* mAdapter;
     const UlpLocation mLocation;
     const GpsLocationExtended mLocationExtended;
@@ -97,13 +125,23 @@ struct LocEngReportPosition : public LocMsg {
                          void* locExt,
                          enum loc_sess_status st,
                          LocPosTechMask technology);
+    virtual ~LocEngReportPosition();
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReportPosition"; }
     void locallog() const;
     virtual void log() const;
+    // only intermediate fixes can be superseded by a newer fix
+    inline virtual uint32_t coalesceKey() const {
+        return (LOC_SESS_INTERMEDIATE == mStatus) ?
+            LOC_ENG_MSG_KEY_POSITION : LOC_ENG_MSG_KEY_NONE;
+    }
+    // reports go to the normal lane, which control msgs may overtake
+    inline virtual msg_q_prio_type priority() const { return eMSG_Q_PRIO_NORMAL; }
     void send() const;
 };
 
-struct LocEngReportSv : public LocMsg {
+struct LocEngReportSv : public LocMsg,
+                        public LocPooled<LocEngReportSv, 8> {
     LocAdapterBase* mAdapter;
     const HaxxSvStatus mSvStatus;
     const GpsLocationExtended mLocationExtended;
@@ -113,22 +151,31 @@ struct LocEngReportSv : public LocMsg {
                    GpsLocationExtended &locExtended,
                    void* svExtended);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReportSv"; }
     void locallog() const;
     virtual void log() const;
+    inline virtual uint32_t coalesceKey() const { return LOC_ENG_MSG_KEY_SV; }
+    inline virtual msg_q_prio_type priority() const { return eMSG_Q_PRIO_NORMAL; }
     void send() const;
 };
 
-struct LocEngReportStatus : public LocMsg {
+struct LocEngReportStatus : public LocMsg,
+                            public LocPooled<LocEngReportStatus, 4> {
     LocAdapterBase* mAdapter;
     const GpsStatusValue mStatus;
     LocEngReportStatus(LocAdapterBase* adapter,
                        GpsStatusValue engineStatus);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReportStatus"; }
     void locallog() const;
     virtual void log() const;
+    // same lane as LocEngReportPosition: SESSION_END must not get ahead
+    // of the final fix, which ends the session it reports
+    inline virtual msg_q_prio_type priority() const { return eMSG_Q_PRIO_NORMAL; }
 };
 
-struct LocEngReportNmea : public LocMsg {
+struct LocEngReportNmea : public LocMsg,
+                          public LocPooled<LocEngReportNmea, 16> {
     void* mLocEng;
     char* const mNmea;
     const int mLen;
@@ -139,8 +186,10 @@ struct LocEngReportNmea : public LocMsg {
         delete[] mNmea;
     }
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReportNmea"; }
     void locallog() const;
     virtual void log() const;
+    inline virtual msg_q_prio_type priority() const { return eMSG_Q_PRIO_NORMAL; }
 };
 
 struct LocEngReportXtraServer : public LocMsg {
@@ -155,6 +204,8 @@ struct LocEngReportXtraServer : public LocMsg {
         delete[] mServers;
     }
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReportXtraServer"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_XTRA; }
     void locallog() const;
     virtual void log() const;
 };
@@ -163,6 +214,8 @@ struct LocEngSuplEsOpened : public LocMsg {
     void* mLocEng;
     LocEngSuplEsOpened(void* locEng);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngSuplEsOpened"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
 };
@@ -171,6 +224,8 @@ struct LocEngSuplEsClosed : public LocMsg {
     void* mLocEng;
     LocEngSuplEsClosed(void* locEng);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngSuplEsClosed"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
 };
@@ -180,6 +235,8 @@ struct LocEngRequestSuplEs : public LocMsg {
     const int mID;
     LocEngRequestSuplEs(void* locEng, int id);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngRequestSuplEs"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
 };
@@ -191,6 +248,8 @@ struct LocEngRequestATL : public LocMsg {
     LocEngRequestATL(void* locEng, int id,
                      AGpsExtType agps_type);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngRequestATL"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
 };
@@ -200,6 +259,8 @@ struct LocEngReleaseATL : public LocMsg {
     const int mID;
     LocEngReleaseATL(void* locEng, int id);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReleaseATL"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
 };
@@ -214,6 +275,8 @@ struct LocEngReqRelBIT : public LocMsg {
                     int ipv4, char* ipv6, bool isReq);
     virtual ~LocEngReqRelBIT();
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReqRelBIT"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
     void send() const;
@@ -231,6 +294,8 @@ struct LocEngReqRelWifi : public LocMsg {
                      char* s, char* p, bool isReq);
     virtual ~LocEngReqRelWifi();
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReqRelWifi"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_AGPS; }
     void locallog() const;
     virtual void log() const;
     void send() const;
@@ -240,6 +305,8 @@ struct LocEngRequestXtra : public LocMsg {
     void* mLocEng;
     LocEngRequestXtra(void* locEng);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngRequestXtra"; }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_XTRA; }
     void locallog() const;
     virtual void log() const;
 };
@@ -248,6 +315,7 @@ struct LocEngRequestTime : public LocMsg {
     void* mLocEng;
     LocEngRequestTime(void* locEng);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngRequestTime"; }
     void locallog() const;
     virtual void log() const;
 };
@@ -260,6 +328,7 @@ struct LocEngRequestNi : public LocMsg {
                     GpsNiNotification &notif,
                     const void* data);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngRequestNi"; }
     void locallog() const;
     virtual void log() const;
 };
@@ -268,6 +337,7 @@ struct LocEngDown : public LocMsg {
     void* mLocEng;
     LocEngDown(void* locEng);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngDown"; }
     void locallog() const;
     virtual void log() const;
 };
@@ -276,6 +346,7 @@ struct LocEngUp : public LocMsg {
     void* mLocEng;
     LocEngUp(void* locEng);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngUp"; }
     void locallog() const;
     virtual void log() const;
 };
@@ -284,6 +355,7 @@ struct LocEngGetZpp : public LocMsg {
     LocEngAdapter* mAdapter;
     LocEngGetZpp(LocEngAdapter* adapter);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngGetZpp"; }
     void locallog() const;
     virtual void log() const;
     void send() const;
@@ -295,8 +367,10 @@ struct LocEngReportGpsMeasurement : public LocMsg {
     LocEngReportGpsMeasurement(void* locEng,
                                GpsData &gpsData);
     virtual void proc() const;
+    inline virtual const char* name() const { return "LocEngReportGpsMeasurement"; }
     void locallog() const;
     virtual void log() const;
+    inline virtual msg_q_prio_type priority() const { return eMSG_Q_PRIO_NORMAL; }
 };
 
 #ifdef __cplusplus
@@ -31,6 +31,7 @@
 #define LOG_TAG "LocSvc_eng"
 
 #include <loc_eng.h>
+#include <loc_eng_msg.h>
 #include <MsgTask.h>
 #include "log_util.h"
 #include "platform_lib_includes.h"
@@ -53,6 +54,7 @@ struct LocEngRequestXtraServer : public LocMsg {
     inline virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_XTRA; }
 };
 
 struct LocEngInjectXtraData : public LocMsg {
@@ -80,6 +82,7 @@ struct LocEngInjectXtraData : public LocMsg {
     inline virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_XTRA; }
 };
 
 struct LocEngSetXtraVersionCheck : public LocMsg {
@@ -99,6 +102,7 @@ struct LocEngSetXtraVersionCheck : public LocMsg {
     inline virtual void log() const {
         locallog();
     }
+    inline virtual uint32_t serialKey() const { return LOC_ENG_SERIAL_XTRA; }
 };
 
 /*===========================================================================
@@ -11,15 +11,19 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_SRC_FILES += \
     loc_log.cpp \
+    loc_log_ring.cpp \
     loc_cfg.cpp \
+    loc_cfg_blob.cpp \
     msg_q.c \
     linked_list.c \
+    mem_pool.c \
     loc_target.cpp \
     platform_lib_abstractions/elapsed_millis_since_boot.cpp \
     LocHeap.cpp \
     LocTimer.cpp \
     LocThread.cpp \
     MsgTask.cpp \
+    LocMpscQueue.cpp \
     loc_misc_utils.cpp
 
 # Flag -std=c++11 is not accepted by compiler when LOCAL_CLANG is set to true
@@ -50,3 +54,24 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := libgps.utils_headers
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH) $(LOCAL_PATH)/platform_lib_abstractions
 include $(BUILD_HEADER_LIBRARY)
+
+# Build tool compiling the config files into the binary images
+# loc_read_conf() loads in place of parsing the text. Built from the
+# libc only parsing code, not from the rest of libgps.utils.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    loc_cfg_compile.cpp \
+    loc_cfg_blob.cpp
+
+LOCAL_CFLAGS += \
+     -Wno-unused-parameter
+
+LOCAL_C_INCLUDES:= \
+    $(LOCAL_PATH)
+
+LOCAL_MODULE := loc_cfg_compile
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,102 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_ADAPTIVE_LOCK__
+#define __LOC_ADAPTIVE_LOCK__
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+
+// most a lock() spins before it parks, and the pause within each spin
+#define LOC_ADAPTIVE_LOCK_MAX_SPINS 100
+#if defined(__i386__) || defined(__x86_64__)
+#define LOC_ADAPTIVE_LOCK_PAUSE() __asm__ __volatile__("pause")
+#elif defined(__arm__) || defined(__aarch64__)
+#define LOC_ADAPTIVE_LOCK_PAUSE() __asm__ __volatile__("yield")
+#else
+#define LOC_ADAPTIVE_LOCK_PAUSE()
+#endif
+
+// A mutex for tiny critical sections. A contended lock() first spins for
+// about as long as it took to get the lock the previous times, up to
+// LOC_ADAPTIVE_LOCK_MAX_SPINS, and only then parks the thread on a futex.
+// An uncontended lock() / unlock() is a single atomic op each, with no
+// syscall. Not recursive; no priority inheritance.
+class LocAdaptiveLock {
+    // 0: unlocked; 1: locked; 2: locked, and there may be parked threads
+    std::atomic<int32_t> mState;
+    // running average of the spins it took to get the lock
+    std::atomic<int32_t> mSpins;
+
+    inline void futex(int op, int32_t val) {
+        syscall(SYS_futex, reinterpret_cast<int32_t*>(&mState), op, val, NULL, NULL, 0);
+    }
+    void lockSlow() {
+        int32_t spins = mSpins.load(std::memory_order_relaxed);
+        int32_t maxSpins = spins * 2 + 10;
+        if (maxSpins > LOC_ADAPTIVE_LOCK_MAX_SPINS) {
+            maxSpins = LOC_ADAPTIVE_LOCK_MAX_SPINS;
+        }
+        for (int32_t i = 1; i <= maxSpins; i++) {
+            LOC_ADAPTIVE_LOCK_PAUSE();
+            int32_t state = 0;
+            if (0 == mState.load(std::memory_order_relaxed) &&
+                mState.compare_exchange_weak(state, 1, std::memory_order_acquire)) {
+                mSpins.store(spins + (i - spins) / 8, std::memory_order_relaxed);
+                return;
+            }
+        }
+        mSpins.store(spins + (maxSpins - spins) / 8, std::memory_order_relaxed);
+        // marking the lock as having waiters before parking, so that
+        // unlock() knows to wake one up
+        while (0 != mState.exchange(2, std::memory_order_acquire)) {
+            futex(FUTEX_WAIT_PRIVATE, 2);
+        }
+    }
+
+public:
+    inline LocAdaptiveLock() : mState(0), mSpins(0) {}
+    // locking the lock to enter critical section
+    inline void lock() {
+        int32_t state = 0;
+        if (!mState.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+            lockSlow();
+        }
+    }
+    // unlocking the lock to leave the critical section
+    inline void unlock() {
+        if (2 == mState.exchange(0, std::memory_order_release)) {
+            futex(FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+};
+
+#endif //__LOC_ADAPTIVE_LOCK__
@@ -26,6 +26,7 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
+#include <stdlib.h>
 #include <LocHeap.h>
 
 class LocHeapNode {
@@ -275,7 +276,136 @@ uint32_t LocHeap::getTreeSize() {
 }
 #endif
 
-#ifdef __LOC_DEBUG__
+/***************************LocIndexedHeap methods***************************/
+
+LocIndexedHeap::LocIndexedHeap(uint32_t capacity) :
+    mNodes(NULL), mSize(0), mCapacity(capacity ? capacity : 1) {
+}
+
+// nodes are owned by the client, only the array is ours
+LocIndexedHeap::~LocIndexedHeap() {
+    for (uint32_t i = 0; i < mSize; i++) {
+        mNodes[i]->mHeapIndex = LOC_HEAP_NO_INDEX;
+    }
+    free(mNodes);
+}
+
+inline
+void LocIndexedHeap::place(LocRankable& node, uint32_t index) {
+    mNodes[index] = &node;
+    node.mHeapIndex = index;
+}
+
+// moves the node at index up, for as long as it outranks its parent
+void LocIndexedHeap::siftUp(uint32_t index) {
+    LocRankable* node = mNodes[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / ARITY;
+        if (!node->outRanks(*mNodes[parent])) {
+            break;
+        }
+        place(*mNodes[parent], index);
+        index = parent;
+    }
+    place(*node, index);
+}
+
+// moves the node at index down, for as long as a child outranks it
+void LocIndexedHeap::siftDown(uint32_t index) {
+    LocRankable* node = mNodes[index];
+    for (uint32_t first = index * ARITY + 1; first < mSize; first = index * ARITY + 1) {
+        // the highest ranking child
+        uint32_t top = first;
+        uint32_t last = (first + ARITY < mSize) ? first + ARITY : mSize;
+        for (uint32_t child = first + 1; child < last; child++) {
+            if (mNodes[child]->outRanks(*mNodes[top])) {
+                top = child;
+            }
+        }
+        if (!mNodes[top]->outRanks(*node)) {
+            break;
+        }
+        place(*mNodes[top], index);
+        index = top;
+    }
+    place(*node, index);
+}
+
+void LocIndexedHeap::fill(uint32_t index) {
+    mSize--;
+    if (index < mSize) {
+        place(*mNodes[mSize], index);
+        // the last node may go either way, compared to the one it replaces
+        if (index > 0 && mNodes[index]->outRanks(*mNodes[(index - 1) / ARITY])) {
+            siftUp(index);
+        } else {
+            siftDown(index);
+        }
+    }
+}
+
+bool LocIndexedHeap::push(LocRankable& node) {
+    if (NULL == mNodes || mSize == mCapacity) {
+        uint32_t capacity = mNodes ? mCapacity * 2 : mCapacity;
+        LocRankable** nodes = (LocRankable**)realloc(mNodes, capacity * sizeof(LocRankable*));
+        if (NULL == nodes) {
+            return false;
+        }
+        mNodes = nodes;
+        mCapacity = capacity;
+    }
+    place(node, mSize++);
+    siftUp(node.mHeapIndex);
+    return true;
+}
+
+LocRankable* LocIndexedHeap::pop() {
+    LocRankable* top = NULL;
+    if (mSize) {
+        top = mNodes[0];
+        fill(0);
+        top->mHeapIndex = LOC_HEAP_NO_INDEX;
+    }
+    return top;
+}
+
+LocRankable* LocIndexedHeap::remove(LocRankable& rankable) {
+    uint32_t index = rankable.mHeapIndex;
+    if (index >= mSize || mNodes[index] != &rankable) {
+        return NULL;
+    }
+    fill(index);
+    rankable.mHeapIndex = LOC_HEAP_NO_INDEX;
+    return &rankable;
+}
+
+bool LocIndexedHeap::update(LocRankable& rankable) {
+    uint32_t index = rankable.mHeapIndex;
+    if (index >= mSize || mNodes[index] != &rankable) {
+        return false;
+    }
+    if (index > 0 && rankable.outRanks(*mNodes[(index - 1) / ARITY])) {
+        siftUp(index);
+    } else {
+        siftDown(index);
+    }
+    return true;
+}
+
+#ifdef __LOC_UNIT_TEST__
+// every node is where its index says, and no child outranks its parent
+bool LocIndexedHeap::checkHeap() {
+    for (uint32_t i = 0; i < mSize; i++) {
+        if (mNodes[i]->mHeapIndex != i ||
+            (i > 0 && mNodes[i]->outRanks(*mNodes[(i - 1) / ARITY]))) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+#if defined(__LOC_DEBUG__) && !defined(__LOC_UNIT_TEST__)
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -352,3 +482,150 @@ int main(int argc, char** argv) {
 }
 
 #endif
+
+#ifdef __LOC_UNIT_TEST__
+
+#include <stdio.h>
+#include <time.h>
+
+class LocHeapTestData : public LocRankable {
+public:
+    const int mID;
+    LocHeapTestData(int id) : mID(id) {}
+    inline virtual int ranks(LocRankable& rankable) {
+        return ((LocHeapTestData&)rankable).mID - mID;
+    }
+};
+
+static double getElapsedMs(struct timespec& from) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - from.tv_sec) * 1000.0 + (now.tv_nsec - from.tv_nsec) / 1000000.0;
+}
+
+// Randomly pushes, pops and removes the same nodes in a LocHeap and a
+// LocIndexedHeap, checking that both agree, then times the two doing the
+// timer like pattern of pushing n nodes and removing them in random order.
+// For Linux command line testing:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_UNIT_TEST__ -g -O2 -I. -I../../../../system/core/include LocHeap.cpp
+// test: ./a.out 10000
+int main(int argc, char** argv) {
+    srand(time(NULL));
+    int tries = (argc > 1) ? atoi(argv[1]) : 10000;
+    int checks = (tries >> 3) ? (tries >> 3) : 1;
+    LocHeap heap;
+    LocIndexedHeap indexedHeap;
+    // the indexed heap gets its own copies, a node is in one heap at a time
+    LocHeapTestData** nodes = new LocHeapTestData*[tries];
+    LocHeapTestData** indexedNodes = new LocHeapTestData*[tries];
+    int numNodes = 0;
+
+    for (int i = 0; i < tries; i++) {
+        int r = rand();
+        if (r % 3 == 0 && numNodes) {
+            // remove a random node from both
+            int n = (r >> 2) % numNodes;
+            if (heap.remove(*nodes[n]) != nodes[n] ||
+                indexedHeap.remove(*indexedNodes[n]) != indexedNodes[n]) {
+                printf("remove failed at %dth op\n", i);
+                return 1;
+            }
+            delete nodes[n];
+            delete indexedNodes[n];
+            numNodes--;
+            nodes[n] = nodes[numNodes];
+            indexedNodes[n] = indexedNodes[numNodes];
+        } else if (r % 3 == 1 && numNodes) {
+            LocHeapTestData* top = (LocHeapTestData*)heap.pop();
+            LocHeapTestData* indexedTop = (LocHeapTestData*)indexedHeap.pop();
+            if (top->mID != indexedTop->mID) {
+                printf("pop mismatch at %dth op: %d != %d\n", i, top->mID, indexedTop->mID);
+                return 1;
+            }
+            // tied ids may come out as different objs, drop them by value
+            for (int n = 0; n < numNodes; n++) {
+                if (nodes[n] == top) {
+                    nodes[n] = nodes[numNodes - 1];
+                    break;
+                }
+            }
+            for (int n = 0; n < numNodes; n++) {
+                if (indexedNodes[n] == indexedTop) {
+                    indexedNodes[n] = indexedNodes[numNodes - 1];
+                    break;
+                }
+            }
+            numNodes--;
+            delete top;
+            delete indexedTop;
+        } else {
+            int id = r % (tries * 4);
+            nodes[numNodes] = new LocHeapTestData(id);
+            indexedNodes[numNodes] = new LocHeapTestData(id);
+            heap.push(*nodes[numNodes]);
+            indexedHeap.push(*indexedNodes[numNodes]);
+            numNodes++;
+        }
+        if ((i % checks == 0 || i == tries - 1) &&
+            (!heap.checkTree() || !indexedHeap.checkHeap() ||
+             heap.getTreeSize() != indexedHeap.getSize() ||
+             (uint32_t)numNodes != indexedHeap.getSize())) {
+            printf("heap check failed at %dth op\n", i);
+            return 1;
+        }
+    }
+    for (int n = 0; n < numNodes; n++) {
+        heap.remove(*nodes[n]);
+        indexedHeap.remove(*indexedNodes[n]);
+        delete nodes[n];
+        delete indexedNodes[n];
+    }
+    printf("%d random ops: both heaps agree\n", tries);
+
+    // push all, then remove in random order, i.e. timers mostly stopped
+    // before they expire
+    int* order = new int[tries];
+    for (int n = 0; n < tries; n++) {
+        nodes[n] = new LocHeapTestData(rand());
+        order[n] = n;
+    }
+    for (int n = tries - 1; n > 0; n--) {
+        int k = rand() % (n + 1);
+        int tmp = order[n];
+        order[n] = order[k];
+        order[k] = tmp;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < tries; n++) {
+        heap.push(*nodes[n]);
+    }
+    for (int n = 0; n < tries; n++) {
+        heap.remove(*nodes[order[n]]);
+    }
+    double heapMs = getElapsedMs(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < tries; n++) {
+        indexedHeap.push(*nodes[n]);
+    }
+    for (int n = 0; n < tries; n++) {
+        indexedHeap.remove(*nodes[order[n]]);
+    }
+    double indexedMs = getElapsedMs(start);
+
+    printf("push + remove %d nodes: LocHeap %.3f ms, LocIndexedHeap %.3f ms\n",
+           tries, heapMs, indexedMs);
+
+    for (int n = 0; n < tries; n++) {
+        delete nodes[n];
+    }
+    delete[] order;
+    delete[] nodes;
+    delete[] indexedNodes;
+
+    return 0;
+}
+
+#endif
@@ -30,11 +30,21 @@
 #define __LOC_HEAP__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+#define LOC_HEAP_NO_INDEX 0xFFFFFFFF
+
 // abstract class to be implemented by client to provide a rankable class
 class LocRankable {
+    friend class LocIndexedHeap;
+    // where this obj is in the LocIndexedHeap it was pushed into, if any
+    uint32_t mHeapIndex;
 public:
+    inline LocRankable() : mHeapIndex(LOC_HEAP_NO_INDEX) {}
+    // a copy is in no heap
+    inline LocRankable(const LocRankable&) : mHeapIndex(LOC_HEAP_NO_INDEX) {}
+    inline LocRankable& operator=(const LocRankable&) { return *this; }
     virtual inline ~LocRankable() {}
 
     // method to rank objects of such type for sorting purposes.
@@ -93,4 +103,52 @@ public:
 #endif
 };
 
+// a d-ary heap kept in a contiguous array, with the same push / peek / pop
+// / remove semantics as LocHeap. Each LocRankable keeps its own index in
+// the array, so remove() and update() take O(log n) with no searching, and
+// push() allocates nothing unless the array is full. A LocRankable can be
+// in at most one LocIndexedHeap at a time.
+class LocIndexedHeap {
+    // children of node i are [i * ARITY + 1, i * ARITY + ARITY]
+    static const uint32_t ARITY = 4;
+    void place(LocRankable& node, uint32_t index);
+    void siftUp(uint32_t index);
+    void siftDown(uint32_t index);
+    // moves the last node into index and re-sorts it
+    void fill(uint32_t index);
+protected:
+    LocRankable** mNodes;
+    uint32_t mSize;
+    uint32_t mCapacity;
+public:
+    // capacity is the number of nodes the array is first allocated for, on
+    // the first push(); it doubles each time it is full.
+    LocIndexedHeap(uint32_t capacity = 16);
+    ~LocIndexedHeap();
+
+    // returns false if the array could not grow, in which case node is
+    //         not in the heap.
+    bool push(LocRankable& node);
+
+    // Returns NULL if the heap is empty, otherwise the highest ranking node
+    inline LocRankable* peek() { return mSize ? mNodes[0] : NULL; }
+
+    // Return - pointer to the node popped out, or NULL if heap is already empty
+    LocRankable* pop();
+
+    // removes the node from the heap, located by its index, not by rank.
+    // returns the pointer to the node removed; or NULL if not in this heap.
+    LocRankable* remove(LocRankable& rankable);
+
+    // re-sorts a node in the heap whose rank has just changed, e.g. a new
+    // time out. returns false if the node is not in this heap.
+    bool update(LocRankable& rankable);
+
+    inline uint32_t getSize() { return mSize; }
+
+#ifdef __LOC_UNIT_TEST__
+    bool checkHeap();
+#endif
+};
+
 #endif //__LOC_HEAP__
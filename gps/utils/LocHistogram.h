@@ -0,0 +1,76 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_HISTOGRAM__
+#define __LOC_HISTOGRAM__
+
+#include <stdint.h>
+
+// Log2 buckets of microseconds: bucket 0 is < 1us, bucket i is
+// [2^(i-1), 2^i) us, and the last one takes all from 2^(N-2) us up.
+// Not thread safe; users serialize add() against the readers.
+template <uint32_t N>
+struct LocHistogram {
+    uint64_t mSumUs;
+    uint32_t mMaxUs;
+    uint32_t mBuckets[N];
+
+    inline void add(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        uint32_t i = 0;
+        for (uint64_t v = us; v && i < N - 1; v >>= 1) {
+            i++;
+        }
+        mBuckets[i]++;
+        mSumUs += us;
+        if (us > mMaxUs) {
+            mMaxUs = (us > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)us;
+        }
+    }
+    inline uint64_t getCount() const {
+        uint64_t count = 0;
+        for (uint32_t i = 0; i < N; i++) {
+            count += mBuckets[i];
+        }
+        return count;
+    }
+    // upper bound, in us, of the bucket the pct'th percentile falls in
+    inline uint32_t percentile(uint64_t count, uint32_t pct) const {
+        uint64_t target = (count * pct + 99) / 100;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < N - 1; i++) {
+            seen += mBuckets[i];
+            if (seen >= target) {
+                return ((1U << i) < mMaxUs) ? (1U << i) : mMaxUs;
+            }
+        }
+        return mMaxUs;
+    }
+};
+
+#endif //__LOC_HISTOGRAM__
@@ -0,0 +1,214 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <sched.h>
+#include <LocMpscQueue.h>
+
+// This is the classic intrusive MPSC queue with a stub node. Producers
+// serialize on a single atomic exchange of mHead, the consumer walks from
+// mTail following mNext. There is a short window in push(), between the
+// exchange and the store to prev->mNext, in which the new link is not yet
+// reachable from mTail; the consumer sees a non empty but unlinked queue,
+// and simply yields until the producer completes.
+
+LocMpscQueue::LocMpscQueue() :
+    mHead(&mStub), mTail(&mStub), mSleeping(false), mUnblocked(false) {
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mCond, NULL);
+}
+
+LocMpscQueue::~LocMpscQueue() {
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mMutex);
+}
+
+inline
+void LocMpscQueue::append(LocMpscLink& link) {
+    link.mNext.store(NULL, std::memory_order_relaxed);
+    LocMpscLink* prev = mHead.exchange(&link);
+    prev->mNext.store(&link, std::memory_order_release);
+}
+
+bool LocMpscQueue::push(LocMpscLink& link) {
+    if (mUnblocked.load()) {
+        return false;
+    }
+
+    append(link);
+
+    // the exchange in append() and the load here are both sequentially
+    // consistent, as are the store of mSleeping and the load of mHead in
+    // pop(). So either we see the consumer going to sleep, or the consumer
+    // sees our link. Only in the former case do we need the mutex.
+    if (mSleeping.load()) {
+        pthread_mutex_lock(&mMutex);
+        mSleeping.store(false);
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    return true;
+}
+
+LocMpscLink* LocMpscQueue::tryPop() {
+    LocMpscLink* tail = mTail;
+    LocMpscLink* next = tail->mNext.load(std::memory_order_acquire);
+
+    // skip over the stub
+    if (&mStub == tail) {
+        if (NULL == next) {
+            return NULL;
+        }
+        mTail = tail = next;
+        next = next->mNext.load(std::memory_order_acquire);
+    }
+
+    if (NULL != next) {
+        mTail = next;
+        return tail;
+    }
+
+    // tail is the last reachable link. If it is not also the head, a
+    // producer is in the middle of linking after it.
+    if (tail != mHead.load()) {
+        return NULL;
+    }
+
+    // tail is the only link, put the stub back behind it so that tail
+    // can be handed out without leaving the queue dangling.
+    append(mStub);
+    next = tail->mNext.load(std::memory_order_acquire);
+    if (NULL != next) {
+        mTail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+LocMpscLink* LocMpscQueue::pop() {
+    LocMpscLink* link = NULL;
+
+    while (NULL == (link = tryPop()) && !mUnblocked.load()) {
+        if (!isEmpty()) {
+            // a producer is half way through push()
+            sched_yield();
+        } else {
+            pthread_mutex_lock(&mMutex);
+            mSleeping.store(true);
+            // check once more after announcing that we are going to sleep
+            while (mSleeping.load() && isEmpty() && !mUnblocked.load()) {
+                pthread_cond_wait(&mCond, &mMutex);
+            }
+            mSleeping.store(false);
+            pthread_mutex_unlock(&mMutex);
+        }
+    }
+
+    return link;
+}
+
+void LocMpscQueue::unblock() {
+    pthread_mutex_lock(&mMutex);
+    mUnblocked.store(true);
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mMutex);
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct LocMpscDebugData : public LocMpscLink {
+    int mProducer;
+    int mSeq;
+    inline LocMpscDebugData(int producer, int seq) :
+        LocMpscLink(), mProducer(producer), mSeq(seq) {}
+};
+
+static LocMpscQueue* gQueue;
+static int gCount;
+
+static void* produce(void* arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i < gCount; i++) {
+        gQueue->push(*(new LocMpscDebugData(id, i)));
+    }
+    return NULL;
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_DEBUG__ -g -std=c++11 -I. LocMpscQueue.cpp -lpthread
+// test: valgrind ./a.out 4 100000
+int main(int argc, char** argv) {
+    int producers = atoi(argv[1]);
+    gCount = atoi(argv[2]);
+    gQueue = new LocMpscQueue();
+    pthread_t* threads = new pthread_t[producers];
+    int* lastSeq = new int[producers];
+
+    for (int i = 0; i < producers; i++) {
+        lastSeq[i] = -1;
+        pthread_create(&threads[i], NULL, produce, (void*)(long)i);
+    }
+
+    bool success = true;
+    for (long total = (long)producers * gCount; total > 0; total--) {
+        LocMpscDebugData* data = static_cast<LocMpscDebugData*>(gQueue->pop());
+        // FIFO must hold per producer
+        if (data->mSeq != lastSeq[data->mProducer] + 1) {
+            printf("!!!!!!!!!! producer %d: %d after %d\n",
+                   data->mProducer, data->mSeq, lastSeq[data->mProducer]);
+            success = false;
+        }
+        lastSeq[data->mProducer] = data->mSeq;
+        delete data;
+    }
+
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    LocMpscDebugData extra(0, 0);
+    gQueue->unblock();
+    if (NULL != gQueue->pop() || gQueue->push(extra)) {
+        printf("!!!!!!!!!! queue still usable after unblock()\n");
+        success = false;
+    }
+
+    printf("%s\n", success ? "success!" : "failed");
+
+    delete[] lastSeq;
+    delete[] threads;
+    delete gQueue;
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_MPSC_QUEUE__
+#define __LOC_MPSC_QUEUE__
+
+#include <stddef.h>
+#include <pthread.h>
+#include <atomic>
+
+// intrusive link of an obj to be queued into LocMpscQueue. The obj to be
+// queued must extend this class, so that no memory needs to be allocated
+// by the queue for each push.
+class LocMpscLink {
+    friend class LocMpscQueue;
+    std::atomic<LocMpscLink*> mNext;
+public:
+    inline LocMpscLink() : mNext(NULL) {}
+    // the link is a property of where the obj sits in a queue, not of
+    // the obj itself, so it is never copied over.
+    inline LocMpscLink(const LocMpscLink&) : mNext(NULL) {}
+    inline LocMpscLink& operator=(const LocMpscLink&) { return *this; }
+};
+
+// An intrusive multiple producer / single consumer queue. push() is lock
+// free and wait free, and can be called from any number of threads. pop()
+// must be called from one and only one (consumer) thread. The consumer
+// parks on a condition variable only when the queue is truly empty, and
+// producers only take the mutex to wake up a parked consumer.
+class LocMpscQueue {
+    // producers append at mHead
+    std::atomic<LocMpscLink*> mHead;
+    // consumer takes from mTail; only ever touched by the consumer
+    LocMpscLink* mTail;
+    // place holder so that mHead / mTail never need to be NULL
+    LocMpscLink mStub;
+    // true when the consumer is (about to be) parked on mCond
+    std::atomic<bool> mSleeping;
+    // true once unblock() is called
+    std::atomic<bool> mUnblocked;
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    // links without waking up the consumer
+    void append(LocMpscLink& link);
+    // consumer side emptiness check
+    inline bool isEmpty() {
+        return (&mStub == mTail) && (&mStub == mHead.load());
+    }
+public:
+    LocMpscQueue();
+    ~LocMpscQueue();
+
+    // appends link to the queue. Can be called from any thread.
+    // returns false if the queue has been unblocked, in which case
+    //         the obj is not queued, and caller still owns it.
+    bool push(LocMpscLink& link);
+
+    // takes the oldest link out of the queue without blocking.
+    // consumer thread only.
+    // returns NULL if the queue is empty; or a producer is in the middle
+    //         of push() for the only link in the queue.
+    LocMpscLink* tryPop();
+
+    // takes the oldest link out of the queue, parks the caller if the
+    // queue is empty. consumer thread only.
+    // returns NULL only when the queue has been unblocked.
+    LocMpscLink* pop();
+
+    // wakes up the consumer, after which push() / pop() fail. Links
+    // still in the queue can be flushed with tryPop().
+    void unblock();
+};
+
+#endif //__LOC_MPSC_QUEUE__
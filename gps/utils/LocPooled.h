@@ -0,0 +1,80 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_POOLED__
+#define __LOC_POOLED__
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <mem_pool.h>
+
+// Class level allocator for objs that are new'ed and deleted at a high
+// rate, such as report LocMsg's. A class T opts in by also extending
+// LocPooled<T, N>, e.g.
+//     struct LocFooReport : public LocMsg, public LocPooled<LocFooReport, 8>
+// after which new / delete of a T take from / give back to a pool of N T's
+// shared by all threads, falling back to the heap if all N are in use.
+// Objs of classes further derived from T do not fit in the pool, so they
+// always come from the heap. T must have a virtual destructor if it is
+// deleted through a base class pointer, as LocMsg's are.
+template <typename T, uint32_t N>
+class LocPooled {
+    // created on first use; never destroyed, as objs may outlive statics
+    static inline void* pool() {
+        static void* sPool = createPool();
+        return sPool;
+    }
+    static inline void* createPool() {
+        void* pool = NULL;
+        if (eMEM_POOL_SUCCESS != mem_pool_init(&pool, sizeof(T), N)) {
+            pool = NULL;
+        }
+        return pool;
+    }
+public:
+    // returns NULL, rather than throwing, if memory runs out
+    static inline void* operator new(size_t size) throw() {
+        void* pool = (sizeof(T) == size) ? LocPooled::pool() : NULL;
+        return (NULL != pool) ? mem_pool_alloc(pool) : malloc(size);
+    }
+    static inline void operator delete(void* ptr, size_t size) {
+        void* pool = (sizeof(T) == size) ? LocPooled::pool() : NULL;
+        if (NULL != pool) {
+            mem_pool_free(pool, ptr);
+        } else {
+            free(ptr);
+        }
+    }
+    // snapshot of the hits / misses of the pool of T's
+    static inline bool getPoolStats(mem_pool_stats_type& stats) {
+        void* pool = LocPooled::pool();
+        return (NULL != pool) && (eMEM_POOL_SUCCESS == mem_pool_get_stats(pool, &stats));
+    }
+};
+
+#endif //__LOC_POOLED__
@@ -30,8 +30,8 @@
 #define __LOC_SHARED_LOCK__
 
 #include <stddef.h>
-#include <cutils/atomic.h>
-#include <pthread.h>
+#include <atomic>
+#include <LocAdaptiveLock.h>
 
 // This is a utility created for use cases such that there are more than
 // one client who need to share the same lock, but it is not predictable
@@ -39,21 +39,28 @@
 // itself when the last client calls its drop() method. To add a cient,
 // this share lock's share() method has to be called, so that the obj
 // can maintain an accurate client count.
+// The critical sections it guards, e.g. in LocTimer, are tiny, hence the
+// spin-then-park LocAdaptiveLock rather than a pthread_mutex_t.
 class LocSharedLock {
-    volatile int32_t mRef;
-    pthread_mutex_t mMutex;
-    inline ~LocSharedLock() { pthread_mutex_destroy(&mMutex); }
+    std::atomic<int32_t> mRef;
+    LocAdaptiveLock mLock;
+    inline ~LocSharedLock() {}
 public:
     // first client to create this LockSharedLock
-    inline LocSharedLock() : mRef(1) { pthread_mutex_init(&mMutex, NULL); }
+    inline LocSharedLock() : mRef(1) {}
     // following client(s) are to *share()* this lock created by the first client
-    inline LocSharedLock* share() { android_atomic_inc(&mRef); return this; }
+    inline LocSharedLock* share() {
+        mRef.fetch_add(1, std::memory_order_relaxed);
+        return this;
+    }
     // whe a client no longer needs this shared lock, drop() shall be called.
-    inline void drop() { if (1 == android_atomic_dec(&mRef)) delete this; }
+    inline void drop() {
+        if (1 == mRef.fetch_sub(1, std::memory_order_acq_rel)) delete this;
+    }
     // locking the lock to enter critical section
-    inline void lock() { pthread_mutex_lock(&mMutex); }
+    inline void lock() { mLock.lock(); }
     // unlocking the lock to leave the critical section
-    inline void unlock() { pthread_mutex_unlock(&mMutex); }
+    inline void unlock() { mLock.unlock(); }
 };
 
 #endif //__LOC_SHARED_LOCK__
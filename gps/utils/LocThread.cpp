@@ -26,9 +26,96 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LocThread"
+
 #include <LocThread.h>
 #include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <loc_cfg.h>
+#include <log_util.h>
+
+// config file the profiles are looked up in; none until setConfFile()
+static const char* sLocThreadConfFile = NULL;
+
+void LocThreadProfile::setConfFile(const char* confFileName) {
+    sLocThreadConfFile = confFileName;
+}
+
+bool LocThreadProfile::read(const char* threadName) {
+    if (NULL == sLocThreadConfFile) {
+        return false;
+    }
+    int policy = -1;
+    int priority = 0;
+    int cpuMask = 0;
+    int stackSizeKb = 0;
+    uint8_t policySet = 0;
+    char names[4][LOC_MAX_PARAM_NAME];
+    snprintf(names[0], sizeof(names[0]), "%s_SCHED_POLICY", threadName);
+    snprintf(names[1], sizeof(names[1]), "%s_SCHED_PRIORITY", threadName);
+    snprintf(names[2], sizeof(names[2]), "%s_CPU_AFFINITY", threadName);
+    snprintf(names[3], sizeof(names[3]), "%s_STACK_SIZE_KB", threadName);
+    loc_param_s_type profileTable[] =
+    {
+        {names[0], &policy,      &policySet, 'n'},
+        {names[1], &priority,    NULL,       'n'},
+        {names[2], &cpuMask,     NULL,       'n'},
+        {names[3], &stackSizeKb, NULL,       'n'},
+    };
+    // the store lookup parses the file once, and does not re-apply the
+    // logging parameters, which may have been changed since
+    UTIL_LOOKUP_CONF(sLocThreadConfFile, profileTable);
+
+    if (policySet) {
+        mPolicy = policy;
+        mPriority = priority;
+    }
+    mCpuMask = (uint32_t)cpuMask;
+    mStackSize = (stackSizeKb > 0) ? (size_t)stackSizeKb * 1024 : 0;
+    return !isDefault();
+}
+
+// applies profile to the calling thread
+static void LocThreadApplyProfile(const char* threadName, const LocThreadProfile& profile) {
+    pid_t tid = gettid();
+    if (profile.mCpuMask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (uint32_t cpu = 0; cpu < 32; cpu++) {
+            if (profile.mCpuMask & (1U << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if (sched_setaffinity(tid, sizeof(cpus), &cpus)) {
+            LOC_LOGE("%s: %s cpu mask 0x%x - %s", __FUNCTION__, threadName,
+                     profile.mCpuMask, strerror(errno));
+        }
+    }
+    if (-1 != profile.mPolicy) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        if (SCHED_OTHER != profile.mPolicy) {
+            param.sched_priority = profile.mPriority;
+        }
+        if (sched_setscheduler(tid, profile.mPolicy, &param)) {
+            LOC_LOGE("%s: %s policy %d priority %d - %s", __FUNCTION__, threadName,
+                     profile.mPolicy, profile.mPriority, strerror(errno));
+        } else if (SCHED_OTHER == profile.mPolicy &&
+                   setpriority(PRIO_PROCESS, tid, profile.mPriority)) {
+            LOC_LOGE("%s: %s nice %d - %s", __FUNCTION__, threadName,
+                     profile.mPriority, strerror(errno));
+        }
+    }
+    LOC_LOGD("%s: %s policy %d priority %d cpu mask 0x%x stack %zu", __FUNCTION__,
+             threadName, profile.mPolicy, profile.mPriority, profile.mCpuMask,
+             profile.mStackSize);
+}
 
 class LocThreadDelegate {
     LocRunnable* mRunnable;
@@ -36,13 +123,17 @@ class LocThreadDelegate {
     pthread_t mThandle;
     pthread_mutex_t mMutex;
     int mRefCount;
+    const LocThreadProfile mProfile;
+    char mName[16];
     ~LocThreadDelegate();
     LocThreadDelegate(LocThread::tCreate creator, const char* threadName,
-                      LocRunnable* runnable, bool joinable);
+                      LocRunnable* runnable, bool joinable,
+                      const LocThreadProfile& profile);
     void destroy();
 public:
     static LocThreadDelegate* create(LocThread::tCreate creator,
-            const char* threadName, LocRunnable* runnable, bool joinable);
+            const char* threadName, LocRunnable* runnable, bool joinable,
+            const LocThreadProfile& profile);
     void stop();
     // bye() is for the parent thread to go away. if joinable,
     // parent must stop the spawned thread, join, and then
@@ -63,30 +154,43 @@ public:
 // must be set to  indicate failure, e.g. mRunnable, and
 // threashold approprietly for destroy(), e.g. mRefCount.
 LocThreadDelegate::LocThreadDelegate(LocThread::tCreate creator,
-        const char* threadName, LocRunnable* runnable, bool joinable) :
+        const char* threadName, LocRunnable* runnable, bool joinable,
+        const LocThreadProfile& profile) :
     mRunnable(runnable), mJoinable(joinable), mThandle(NULL),
-    mMutex(PTHREAD_MUTEX_INITIALIZER), mRefCount(2) {
+    mMutex(PTHREAD_MUTEX_INITIALIZER), mRefCount(2), mProfile(profile) {
 
     // set up thread name, if nothing is passed in
     if (!threadName) {
         threadName = "LocThread";
     }
+    strlcpy(mName, threadName, sizeof(mName));
 
     // create the thread here, then if successful
     // and a name is given, we set the thread name
     if (creator) {
+        if (profile.mStackSize) {
+            LOC_LOGW("%s: %s stack size not applicable to creator made threads",
+                     __FUNCTION__, mName);
+        }
         mThandle = creator(threadName, threadMain, this);
-    } else if (pthread_create(&mThandle, NULL, threadMain, this)) {
-        // pthread_create() failed
-        mThandle = NULL;
+    } else {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (profile.mStackSize &&
+            pthread_attr_setstacksize(&attr, profile.mStackSize)) {
+            LOC_LOGE("%s: %s stack size %zu invalid", __FUNCTION__, mName,
+                     profile.mStackSize);
+        }
+        if (pthread_create(&mThandle, &attr, threadMain, this)) {
+            // pthread_create() failed
+            mThandle = NULL;
+        }
+        pthread_attr_destroy(&attr);
     }
 
     if (mThandle) {
-        // set thread name
-        char lname[16];
-        strlcpy(lname, threadName, sizeof(lname));
         // set the thread name here
-        pthread_setname_np(mThandle, lname);
+        pthread_setname_np(mThandle, mName);
 
         // detach, if not joinable
         if (!joinable) {
@@ -107,10 +211,11 @@ LocThreadDelegate::~LocThreadDelegate() {
 
 // factory method so that we could return NULL upon failure
 LocThreadDelegate* LocThreadDelegate::create(LocThread::tCreate creator,
-        const char* threadName, LocRunnable* runnable, bool joinable) {
+        const char* threadName, LocRunnable* runnable, bool joinable,
+        const LocThreadProfile& profile) {
     LocThreadDelegate* thread = NULL;
     if (runnable) {
-        thread = new LocThreadDelegate(creator, threadName, runnable, joinable);
+        thread = new LocThreadDelegate(creator, threadName, runnable, joinable, profile);
         if (thread && !thread->isRunning()) {
             thread->destroy();
             thread = NULL;
@@ -179,6 +284,9 @@ void* LocThreadDelegate::threadMain(void* arg) {
         if (runnable) {
             if (locThread->isRunning()) {
                 runnable->prerun();
+                if (!locThread->mProfile.isDefault()) {
+                    LocThreadApplyProfile(locThread->mName, locThread->mProfile);
+                }
             }
 
             while (locThread->isRunning() && runnable->run());
@@ -206,16 +314,26 @@ LocThread::~LocThread() {
     }
 }
 
-bool LocThread::start(tCreate creator, const char* threadName, LocRunnable* runnable, bool joinable) {
+bool LocThread::start(tCreate creator, const char* threadName, LocRunnable* runnable,
+                      bool joinable, const LocThreadProfile& profile) {
     bool success = false;
     if (!mThread) {
-        mThread = LocThreadDelegate::create(creator, threadName, runnable, joinable);
+        mThread = LocThreadDelegate::create(creator, threadName, runnable, joinable,
+                                            profile);
         // true only if thread is created successfully
         success = (NULL != mThread);
     }
     return success;
 }
 
+bool LocThread::start(tCreate creator, const char* threadName, LocRunnable* runnable, bool joinable) {
+    LocThreadProfile profile;
+    if (threadName) {
+        profile.read(threadName);
+    }
+    return start(creator, threadName, runnable, joinable, profile);
+}
+
 void LocThread::stop() {
     if (mThread) {
         mThread->stop();
@@ -30,6 +30,7 @@
 #define __LOC_THREAD__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 
 // abstract class to be implemented by client to provide a runnable class
@@ -54,6 +55,32 @@ public:
     inline virtual void postrun() {}
 };
 
+// How a LocThread is to be scheduled. Applied by the thread itself, after
+// LocRunnable::prerun(), so it takes precedence over what prerun() sets.
+struct LocThreadProfile {
+    // SCHED_OTHER, SCHED_FIFO or SCHED_RR; -1 to leave as inherited
+    int mPolicy;
+    // nice value for SCHED_OTHER, 1 - 99 for SCHED_FIFO / SCHED_RR
+    int mPriority;
+    // cpus the thread may run on, bit n for cpu n; 0 for any
+    uint32_t mCpuMask;
+    // stack size in bytes; 0 for the default. Not applicable to threads
+    // made by a tCreate creator, as those are not created by LocThread.
+    size_t mStackSize;
+    inline LocThreadProfile() : mPolicy(-1), mPriority(0), mCpuMask(0), mStackSize(0) {}
+    // fills in from the <threadName>_SCHED_POLICY, _SCHED_PRIORITY,
+    // _CPU_AFFINITY and _STACK_SIZE_KB items of the file given to
+    // setConfFile(), if any. Returns true if the profile is other than
+    // default.
+    bool read(const char* threadName);
+    // config file the profiles of threads started from now on are read
+    // from, e.g. gps.conf. It is parsed once; the name must stay valid.
+    static void setConfFile(const char* confFileName);
+    inline bool isDefault() const {
+        return -1 == mPolicy && 0 == mCpuMask && 0 == mStackSize;
+    }
+};
+
 // opaque class to provide service implementation.
 class LocThreadDelegate;
 
@@ -75,7 +102,11 @@ public:
     //          The obj will be deleted by LocThread if start()
     //          returns true. Else it is client's responsibility
     //          to delete the object
+    // profile is how the thread is to be scheduled. If not given, it is
+    //          read by threadName, see LocThreadProfile::setConfFile().
     // Returns 0 if success; false if failure.
+    bool start(tCreate creator, const char* threadName, LocRunnable* runnable,
+               bool joinable, const LocThreadProfile& profile);
     bool start(tCreate creator, const char* threadName, LocRunnable* runnable, bool joinable = true);
     inline bool start(const char* threadName, LocRunnable* runnable, bool joinable = true) {
         return start(NULL, threadName, runnable, joinable);
@@ -39,6 +39,11 @@
 #include <LocThread.h>
 #include <LocSharedLock.h>
 #include <MsgTask.h>
+#include <LocPooled.h>
+#include <LocHistogram.h>
+#include <loc_cfg.h>
+#include <math.h>
+#include <atomic>
 
 #ifdef __HOST_UNIT_TEST__
 #define EPOLLWAKEUP 0
@@ -46,9 +51,32 @@
 #define CLOCK_BOOTTIME_ALARM CLOCK_MONOTONIC
 #endif
 
+#ifndef GPS_CONF_FILE
+#define GPS_CONF_FILE            "/etc/gps.conf"
+#endif
+
+// log2 us buckets of callback lateness, the last one takes all from ~4 sec up
+#define LOC_TIMER_LATE_BUCKETS 24
+
+// LocTimerContainer backends, TIMER_BACKEND in gps.conf
+#define LOC_TIMER_BACKEND_HEAP   0
+#define LOC_TIMER_BACKEND_WHEEL  1
+// build time default, e.g. LOCAL_CFLAGS += -DLOC_TIMER_BACKEND_DEFAULT=1
+#ifndef LOC_TIMER_BACKEND_DEFAULT
+#define LOC_TIMER_BACKEND_DEFAULT LOC_TIMER_BACKEND_HEAP
+#endif
+
+static uint32_t TIMER_BACKEND = LOC_TIMER_BACKEND_DEFAULT;
+
+static loc_param_s_type timer_conf_table[] =
+{
+    {"TIMER_BACKEND",             &TIMER_BACKEND,             NULL, 'n'},
+};
+
 /*
-There are implementations of 5 classes in this file:
-LocTimer, LocTimerDelegate, LocTimerContainer, LocTimerPollTask, LocTimerWrapper
+There are implementations of 7 classes in this file:
+LocTimer, LocTimerDelegate, LocTimerContainer, LocTimerHeap, LocTimerWheel,
+LocTimerPollTask, LocTimerWrapper
 
 LocTimer - client front end, interface for client to start / stop timers, also
            to provide a callback.
@@ -63,33 +91,61 @@ LocTimerDelegate - an internal timer entity, which also is a LocRankable obj.
                    heap, its ranks() implementation decides where it is placed
                    in the heap.
 LocTimerContainer - core of the timer service. It is a container (derived from
-                    LocHeap) for LocTimerDelegate (implements LocRankable) objs.
+                    LocTimerBackend) for LocTimerDelegate objs.
                     There are 2 of such containers, one for sw timers (or Linux
                     timers) one for hw timers (or Linux alarms). It adds one of
                     each (those that expire the soonest) to kernel via services
                     provided by LocTimerPollTask. All the heap management on the
                     LocTimerDelegate objs are done in the MsgTask context, such
                     that synchronization is ensured.
+LocTimerHeap - default LocTimerBackend, a LocIndexedHeap of LocTimerDelegate
+               (implements LocRankable) objs. O(log n) add / remove, and the
+               kernel timer is set to the exact soonest time out.
+LocTimerWheel - LocTimerBackend of a hierarchical timing wheel, with O(1) add
+                / remove. The kernel timer is set to the start of the soonest
+                non empty bucket, which is where timers either expire or get
+                cascaded down to a finer level.
 LocTimerPollTask - is a class that wraps timerfd and epoll POXIS APIs. It also
                    both implements LocRunnalbe with epoll_wait() in the run()
                    method. It is also a LocThread client, so as to loop the run
-                   method.
+                   method. The MsgTask is a pollable one, so the same thread
+                   polls both the timer / alarm fds and the MsgTask fd, and
+                   is the MsgTask context.
 LocTimerWrapper - a LocTimer client itself, to implement the existing C API with
                   APIs, loc_timer_start() and loc_timer_stop().
 
 */
 
 class LocTimerPollTask;
+class LocTimerDelegate;
+
+// storage of the timers / alarms ticking in a LocTimerContainer. All the
+// methods are called in the MsgTask context only.
+class LocTimerBackend {
+public:
+    virtual inline ~LocTimerBackend() {}
+    // returns false if timer could not be added
+    virtual bool add(LocTimerDelegate& timer) = 0;
+    // returns false if timer is not in, e.g. it has just expired
+    virtual bool remove(LocTimerDelegate& timer) = 0;
+    // time the kernel timer is to go off next at
+    // returns false if there is no timer
+    virtual bool getNextTime(struct timespec& time) = 0;
+    // takes out a timer whose time out is now or earlier
+    // returns NULL if there is none
+    virtual LocTimerDelegate* popExpired(struct timespec& now) = 0;
+};
 
 // This is a multi-functaional class that:
-// * extends the LocHeap class for the detection of head update upon add / remove
-//   events. When that happens, soonest time out changes, so timerfd needs update.
-// * contains the timers, and add / remove them into the heap
+// * detects the change of the soonest time out of its backend upon add /
+//   remove events. When that happens, timerfd needs update.
+// * contains the timers, and add / remove them into the backend
 // * provides and maps 2 of such containers, one for timers (or  mSwTimers), one
 //   for alarms (or mHwTimers);
 // * provides a polling thread;
-// * provides a MsgTask thread for synchronized add / remove / timer client callback.
-class LocTimerContainer : public LocHeap {
+// * provides a MsgTask, drained by the polling thread, for synchronized
+//   add / remove / timer client callback.
+class LocTimerContainer {
     // mutex to synchronize getters of static members
     static pthread_mutex_t mMutex;
     // Container of timers
@@ -102,22 +158,42 @@ class LocTimerContainer : public LocHeap {
     static LocTimerPollTask* mPollTask;
     // timer / alarm fd
     int mDevFd;
+    // the timers / alarms, per TIMER_BACKEND
+    LocTimerBackend* mBackend;
+    // time timerfd is set to go off at, 0 if disarmed
+    struct timespec mArmedTime;
+    // true if timers were added / removed since updateSoonestTime(); the
+    // kernel timer is then updated once per LocTimerPollTask::run()
+    bool mDirty;
+    // LocTimerStats counters, updated in the MsgTask context, read from any
+    std::atomic<uint64_t> mWakeups;
+    std::atomic<uint64_t> mExpired;
+    std::atomic<uint64_t> mCoalesced;
+    // callback lateness, updated in the MsgTask context, read from any
+    // thread, under mLateMutex
+    pthread_mutex_t mLateMutex;
+    LocHistogram<LOC_TIMER_LATE_BUCKETS> mLate;
+    double mLateSumSqUs;
+    uint32_t mWorstLateUs[LOC_TIMER_WORST_CASES];
+    uint64_t mWorstDeadlineMs[LOC_TIMER_WORST_CASES];
     // ctor
     LocTimerContainer(bool wakeOnExpire);
     // dtor
     ~LocTimerContainer();
     static MsgTask* getMsgTaskLocked();
     static LocTimerPollTask* getPollTaskLocked();
-    // extend LocHeap and pop if the top outRanks input
-    LocTimerDelegate* popIfOutRanks(LocTimerDelegate& timer);
-    // update the timer POSIX calls with updated soonest timer spec
-    void updateSoonestTime(LocTimerDelegate* priorTop);
+    static LocTimerBackend* createBackendLocked();
+    // update the timer POSIX calls with updated soonest timer spec, if
+    // it has changed
+    void updateSoonestTime();
+    // the add / remove proper, MsgTask context only
+    void addInline(LocTimerDelegate& timer);
+    void removeInline(LocTimerDelegate& timer);
 
 public:
     // factory method to control the creation of mSwTimers / mHwTimers
     static LocTimerContainer* get(bool wakeOnExpire);
 
-    LocTimerDelegate* getSoonestTimer();
     int getTimerFd();
     // add a timer / alarm obj into the container
     void add(LocTimerDelegate& timer);
@@ -125,6 +201,17 @@ public:
     void remove(LocTimerDelegate& timer);
     // handling of timer / alarm expiration
     void expire();
+    // puts an expired periodic timer back, MsgTask context only
+    inline void readd(LocTimerDelegate& timer) { mBackend->add(timer); }
+    // updateSoonestTime() if timers were added / removed since, MsgTask
+    // context only
+    inline void updateIfDirty() { if (mDirty) updateSoonestTime(); }
+    // records how late past deadline a timeOutCallback() is being called,
+    // MsgTask context only
+    void onCallback(const struct timespec& deadline);
+    // fills in stats from the counters of the container of wakeOnExpire
+    static void getStats(bool wakeOnExpire, LocTimerStats& stats);
+    static void dumpStats();
 };
 
 // This class implements the polling thread that epolls imer / alarm fds.
@@ -141,14 +228,22 @@ public:
 class LocTimerPollTask : public LocRunnable {
     // the epoll fd
     const int mFd;
+    // the pollable MsgTask whose fd is also polled, and drained in run()
+    MsgTask* mMsgTask;
     // the thread that calls run() method
     LocThread* mThread;
+    // the thread id of the above, valid once mRunning is true
+    pthread_t mPollThread;
+    std::atomic<bool> mRunning;
+    // containers to updateIfDirty() at the end of run(), poll thread only
+    LocTimerContainer* mDirty[2];
+    uint32_t mNumDirty;
     friend class LocThreadDelegate;
     // dtor
     ~LocTimerPollTask();
 public:
     // ctor
-    LocTimerPollTask();
+    LocTimerPollTask(MsgTask& msgTask);
     // this obj will be deleted once thread is deleted
     void destroy();
     // add a container of timers. Each contain has a unique device fd, i.e.
@@ -163,34 +258,329 @@ public:
     // the atual timer would have been removed from the container.
     void removePoll(LocTimerContainer& timerContainer);
     // The polling thread context will call this method. This is where
-    // epoll_wait() is blocking and waiting for events..
+    // epoll_wait() is blocking and waiting for events, on the timer / alarm
+    // fds as well as on the MsgTask fd.
     virtual bool run();
+    // records the thread id of the polling thread
+    virtual void prerun();
+    // makes run() updateIfDirty() the container, MsgTask context only
+    inline void markDirty(LocTimerContainer& timerContainer) {
+        for (uint32_t i = 0; i < mNumDirty; i++) {
+            if (mDirty[i] == &timerContainer) {
+                return;
+            }
+        }
+        if (mNumDirty < sizeof(mDirty) / sizeof(mDirty[0])) {
+            mDirty[mNumDirty++] = &timerContainer;
+        }
+    }
+    // true if the caller is the polling thread, i.e. in the MsgTask context
+    inline bool isPollThread() {
+        return mRunning.load() && pthread_equal(mPollThread, pthread_self());
+    }
+};
+
+#define LOC_TIMER_WHEEL_NO_SLOT 0xFFFFFFFF
+
+// intrusive link of a LocTimerDelegate into a slot of LocTimerWheel. A slot
+// is a circular list, whose head is a link itself.
+struct LocTimerWheelLink {
+    LocTimerWheelLink* mPrev;
+    LocTimerWheelLink* mNext;
+    // slot the link is in, LOC_TIMER_WHEEL_NO_SLOT if none
+    uint32_t mSlot;
+    inline LocTimerWheelLink() : mPrev(this), mNext(this), mSlot(LOC_TIMER_WHEEL_NO_SLOT) {}
+    inline bool isEmpty() { return mNext == this; }
+    // appends this link to the list of head
+    inline void link(LocTimerWheelLink& head, uint32_t slot) {
+        mPrev = head.mPrev;
+        mNext = &head;
+        head.mPrev->mNext = this;
+        head.mPrev = this;
+        mSlot = slot;
+    }
+    inline void unlink() {
+        mPrev->mNext = mNext;
+        mNext->mPrev = mPrev;
+        mPrev = mNext = this;
+        mSlot = LOC_TIMER_WHEEL_NO_SLOT;
+    }
 };
 
 // Internal class of timer obj. It gets born when client calls LocTimer::start();
 // and gets deleted when client calls LocTimer::stop() or when the it expire()'s.
 // This class implements LocRankable::ranks() so that when an obj is added into
-// the container (of LocHeap), it gets placed in sorted order.
-class LocTimerDelegate : public LocRankable {
+// the container (of LocTimerHeap), it gets placed in sorted order; and is a
+// LocTimerWheelLink, so that it can be linked into a LocTimerWheel slot.
+// It comes from a pool, as do the msgs that add / remove it, so that
+// start() / stop() normally do not allocate.
+class LocTimerDelegate : public LocRankable, public LocTimerWheelLink,
+                         public LocPooled<LocTimerDelegate, 32> {
     friend class LocTimerContainer;
+    friend class LocTimerHeap;
+    friend class LocTimerWheel;
     friend class LocTimer;
     LocTimer* mClient;
     LocSharedLock* mLock;
+    // earliest time to go off at, i.e. the time out
     struct timespec mFutureTime;
+    // latest time to go off at, mFutureTime plus slack
+    struct timespec mLatestTime;
     LocTimerContainer* mContainer;
+    // 0 for a one shot timer
+    const uint32_t mPeriodInMs;
+    // true from when the add msg is sent until it is proc()'ed. Set by
+    // the starting thread before sending, read / cleared in MsgTask context.
+    bool mAddPending;
     // not a complete obj, just ctor for LocRankable comparisons
     inline LocTimerDelegate(struct timespec& delay)
-        : mClient(NULL), mLock(NULL), mFutureTime(delay), mContainer(NULL) {}
+        : mClient(NULL), mLock(NULL), mFutureTime(delay), mLatestTime(delay),
+          mContainer(NULL), mPeriodInMs(0), mAddPending(false) {}
+    // moves a periodic timer to its next deadline after now, and back into
+    // the container. returns false if it has been stopped.
+    bool rearm();
     inline ~LocTimerDelegate() { if (mLock) { mLock->drop(); mLock = NULL; } }
 public:
-    LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire);
+    LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire,
+                     uint32_t slackInMs, uint32_t periodInMs);
     void destroyLocked();
     // LocRankable virtual method
     virtual int ranks(LocRankable& rankable);
     void expire();
     inline struct timespec getFutureTime() { return mFutureTime; }
+    inline struct timespec getLatestTime() { return mLatestTime; }
+};
+
+static inline bool isNotAfter(const struct timespec& a, const struct timespec& b) {
+    return (a.tv_sec < b.tv_sec) || (a.tv_sec == b.tv_sec && a.tv_nsec <= b.tv_nsec);
+}
+
+static inline void addMs(struct timespec& time, uint32_t ms) {
+    time.tv_sec += ms / 1000;
+    time.tv_nsec += (ms % 1000) * 1000000;
+    if (time.tv_nsec >= 1000000000) {
+        time.tv_sec += time.tv_nsec / 1000000000;
+        time.tv_nsec %= 1000000000;
+    }
+}
+
+/***************************LocTimerHeap methods***************************/
+
+class LocTimerHeap : public LocTimerBackend, public LocIndexedHeap {
+public:
+    inline virtual bool add(LocTimerDelegate& timer) { return push(timer); }
+    inline virtual bool remove(LocTimerDelegate& timer) {
+        return NULL != LocIndexedHeap::remove(timer);
+    }
+    virtual bool getNextTime(struct timespec& time);
+    virtual LocTimerDelegate* popExpired(struct timespec& now);
+};
+
+// The heap is sorted by the latest time of the timers, so the kernel timer
+// is set to go off at the soonest of them. Once it does, all the timers
+// from the top whose time out has been reached go off with it, even if
+// they could have waited more.
+bool LocTimerHeap::getNextTime(struct timespec& time) {
+    LocTimerDelegate* top = (LocTimerDelegate*)peek();
+    if (top) {
+        time = top->getLatestTime();
+    }
+    return (NULL != top);
+}
+
+LocTimerDelegate* LocTimerHeap::popExpired(struct timespec& now) {
+    LocTimerDelegate* top = (LocTimerDelegate*)peek();
+    // pop the top only if it has time out older than now
+    return (top && isNotAfter(top->getFutureTime(), now)) ? (LocTimerDelegate*)pop() : NULL;
+}
+
+/***************************LocTimerWheel methods***************************/
+
+// Timing wheel of LEVELS levels of SLOTS slots each. A tick is 1 ms, and a
+// slot of level n spans SLOTS^n ticks, so the levels cover 64 ms, 4 sec,
+// 4 min and 4.6 hours. A timer goes into the lowest level whose next level
+// bucket it shares with mNowTick, i.e. level 0 if it is due within the
+// current 64 ms bucket of level 1. When the wheel reaches the start of a
+// bucket of level n > 0, the timers in it are cascaded into the levels
+// below, and when it reaches a level 0 slot, the timers in it are due.
+// Timers beyond the top level are put in the top level slot of their own
+// bucket, and simply cascade back into the top level each time the wheel
+// comes around to that slot, until they are close enough.
+class LocTimerWheel : public LocTimerBackend {
+    static const uint32_t SLOT_BITS = 6;
+    static const uint32_t SLOTS = 1 << SLOT_BITS;
+    static const uint32_t LEVELS = 4;
+    // slot of the timers in mExpired
+    static const uint32_t EXPIRED_SLOT = LEVELS * SLOTS;
+    // ms since boot the wheel has been advanced to
+    uint64_t mNowTick;
+    // bit n set if slot n of the level is not empty
+    uint64_t mOccupied[LEVELS];
+    LocTimerWheelLink mSlots[LEVELS * SLOTS];
+    // timers due, not yet popExpired()
+    LocTimerWheelLink mExpired;
+
+    static uint64_t toTick(const struct timespec& time, bool roundUp);
+    void insert(LocTimerDelegate& timer);
+    // soonest tick that has a slot to cascade or to expire
+    bool getNextTick(uint64_t& tick);
+    // moves the wheel to tick, collecting the due timers in mExpired
+    void advance(uint64_t tick);
+public:
+    LocTimerWheel();
+    virtual bool add(LocTimerDelegate& timer);
+    virtual bool remove(LocTimerDelegate& timer);
+    virtual bool getNextTime(struct timespec& time);
+    virtual LocTimerDelegate* popExpired(struct timespec& now);
 };
 
+LocTimerWheel::LocTimerWheel() {
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    mNowTick = toTick(now, false);
+    memset(mOccupied, 0, sizeof(mOccupied));
+}
+
+// a time out never rounds up to an earlier tick, so never fires early
+inline
+uint64_t LocTimerWheel::toTick(const struct timespec& time, bool roundUp) {
+    return (uint64_t)time.tv_sec * 1000 +
+        (time.tv_nsec + (roundUp ? 999999 : 0)) / 1000000;
+}
+
+// A timer with slack goes to the tick in its window that is a multiple of
+// the largest power of 2 that fits in the slack, so that timers with
+// overlapping windows tend to share ticks, and thus wakeups.
+void LocTimerWheel::insert(LocTimerDelegate& timer) {
+    uint64_t tick = toTick(timer.mFutureTime, true);
+    uint64_t latest = toTick(timer.mLatestTime, false);
+    if (latest > tick) {
+        uint64_t grid = 1;
+        while ((grid << 1) <= latest - tick + 1) {
+            grid <<= 1;
+        }
+        tick = (tick + grid - 1) & ~(grid - 1);
+    }
+    if (tick < mNowTick) {
+        tick = mNowTick;
+    }
+    uint32_t level = 0;
+    while (level < LEVELS - 1 &&
+           (tick >> (SLOT_BITS * (level + 1))) != (mNowTick >> (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    uint32_t slot = (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    timer.link(mSlots[level * SLOTS + slot], level * SLOTS + slot);
+    mOccupied[level] |= (1ULL << slot);
+}
+
+bool LocTimerWheel::getNextTick(uint64_t& tick) {
+    bool found = false;
+    for (uint32_t level = 0; level < LEVELS; level++) {
+        if (0 == mOccupied[level]) {
+            continue;
+        }
+        // the current bucket of a level above 0 was cascaded when the
+        // wheel got into it, so the search there starts from the next one
+        uint64_t bucket = (mNowTick >> (SLOT_BITS * level)) + (level ? 1 : 0);
+        uint32_t first = bucket & (SLOTS - 1);
+        // rotate so that bit 0 is the slot of bucket
+        uint64_t rotated = first ? ((mOccupied[level] >> first) |
+                                    (mOccupied[level] << (SLOTS - first)))
+                                 : mOccupied[level];
+        uint64_t next = (bucket + __builtin_ctzll(rotated)) << (SLOT_BITS * level);
+        if (!found || next < tick) {
+            tick = next;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void LocTimerWheel::advance(uint64_t tick) {
+    uint64_t next;
+    while (getNextTick(next) && next <= tick) {
+        mNowTick = next;
+        // from the top, so that cascaded timers can go all the way down
+        for (uint32_t level = LEVELS - 1; level > 0; level--) {
+            uint32_t shift = SLOT_BITS * level;
+            uint32_t slot = (next >> shift) & (SLOTS - 1);
+            if (0 == (next & ((1ULL << shift) - 1)) && (mOccupied[level] & (1ULL << slot))) {
+                // take the list out first, top level timers may go right
+                // back into the same slot
+                LocTimerWheelLink cascade;
+                LocTimerWheelLink& head = mSlots[level * SLOTS + slot];
+                cascade.mNext = head.mNext;
+                cascade.mPrev = head.mPrev;
+                cascade.mNext->mPrev = &cascade;
+                cascade.mPrev->mNext = &cascade;
+                head.mPrev = head.mNext = &head;
+                mOccupied[level] &= ~(1ULL << slot);
+                while (!cascade.isEmpty()) {
+                    LocTimerDelegate* timer = static_cast<LocTimerDelegate*>(cascade.mNext);
+                    timer->unlink();
+                    insert(*timer);
+                }
+            }
+        }
+        uint32_t slot = next & (SLOTS - 1);
+        LocTimerWheelLink& head = mSlots[slot];
+        while (!head.isEmpty()) {
+            LocTimerWheelLink* link = head.mNext;
+            link->unlink();
+            link->link(mExpired, EXPIRED_SLOT);
+        }
+        mOccupied[0] &= ~(1ULL << slot);
+    }
+    if (tick > mNowTick) {
+        mNowTick = tick;
+    }
+}
+
+bool LocTimerWheel::add(LocTimerDelegate& timer) {
+    // keep the wheel current, so that a new timer lands in the right level
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    advance(toTick(now, false));
+    insert(timer);
+    return true;
+}
+
+bool LocTimerWheel::remove(LocTimerDelegate& timer) {
+    uint32_t slot = timer.mSlot;
+    if (LOC_TIMER_WHEEL_NO_SLOT == slot) {
+        return false;
+    }
+    timer.unlink();
+    if (slot < EXPIRED_SLOT && mSlots[slot].isEmpty()) {
+        mOccupied[slot / SLOTS] &= ~(1ULL << (slot % SLOTS));
+    }
+    return true;
+}
+
+bool LocTimerWheel::getNextTime(struct timespec& time) {
+    uint64_t tick = mNowTick;
+    // timers already due go off right away
+    if (!mExpired.isEmpty() || getNextTick(tick)) {
+        time.tv_sec = tick / 1000;
+        time.tv_nsec = (tick % 1000) * 1000000;
+        return true;
+    }
+    return false;
+}
+
+LocTimerDelegate* LocTimerWheel::popExpired(struct timespec& now) {
+    if (mExpired.isEmpty()) {
+        advance(toTick(now, false));
+    }
+    LocTimerDelegate* timer = NULL;
+    if (!mExpired.isEmpty()) {
+        timer = static_cast<LocTimerDelegate*>(mExpired.mNext);
+        timer->unlink();
+    }
+    return timer;
+}
+
 /***************************LocTimerContainer methods***************************/
 
 // Most of these static recources are created on demand. They however are never
@@ -208,7 +598,14 @@ LocTimerPollTask* LocTimerContainer::mPollTask = NULL;
 // A container for swTimer (timer) is created, when wakeOnExpire is true; or
 // HwTimer (alarm), when wakeOnExpire is false.
 LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
-    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)) {
+    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)),
+    mBackend(createBackendLocked()),
+    mDirty(false), mWakeups(0), mExpired(0), mCoalesced(0), mLateSumSqUs(0) {
+    memset(&mArmedTime, 0, sizeof(mArmedTime));
+    memset(&mLate, 0, sizeof(mLate));
+    memset(mWorstLateUs, 0, sizeof(mWorstLateUs));
+    memset(mWorstDeadlineMs, 0, sizeof(mWorstDeadlineMs));
+    pthread_mutex_init(&mLateMutex, NULL);
 
     if ((-1 == mDevFd) && (errno == EINVAL)) {
         LOC_LOGW("%s: timerfd_create failure, fallback to CLOCK_MONOTONIC - %s",
@@ -217,9 +614,9 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
     }
 
     if (-1 != mDevFd) {
-        // ensure we have the necessary resources created
+        // ensure we have the necessary resources created; the poll task
+        // creates the MsgTask it drains.
         LocTimerContainer::getPollTaskLocked();
-        LocTimerContainer::getMsgTaskLocked();
     } else {
         LOC_LOGE("%s: timerfd_create failure - %s", __FUNCTION__, strerror(errno));
     }
@@ -230,6 +627,8 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
 inline
 LocTimerContainer::~LocTimerContainer() {
     close(mDevFd);
+    delete mBackend;
+    pthread_mutex_destroy(&mLateMutex);
 }
 
 LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
@@ -255,146 +654,250 @@ LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
 MsgTask* LocTimerContainer::getMsgTaskLocked() {
     // it is cheap to check pointer first than locking mutext unconditionally
     if (!mMsgTask) {
-        mMsgTask = new MsgTask("LocTimerMsgTask", false);
+        // no thread of its own, LocTimerPollTask drains it
+        MsgTaskConfig config;
+        config.mPollable = true;
+        mMsgTask = new MsgTask("LocTimerMsgTask", false, config);
     }
     return mMsgTask;
 }
 
+LocTimerBackend* LocTimerContainer::createBackendLocked() {
+    static bool confRead = false;
+    if (!confRead) {
+        UTIL_READ_CONF(GPS_CONF_FILE, timer_conf_table);
+        confRead = true;
+        LOC_LOGD("%s: timer backend: %s", __FUNCTION__,
+                 (LOC_TIMER_BACKEND_WHEEL == TIMER_BACKEND) ? "wheel" : "heap");
+    }
+    if (LOC_TIMER_BACKEND_WHEEL == TIMER_BACKEND) {
+        return new LocTimerWheel();
+    }
+    return new LocTimerHeap();
+}
+
 LocTimerPollTask* LocTimerContainer::getPollTaskLocked() {
     // it is cheap to check pointer first than locking mutext unconditionally
     if (!mPollTask) {
-        mPollTask = new LocTimerPollTask();
+        mPollTask = new LocTimerPollTask(*getMsgTaskLocked());
     }
     return mPollTask;
 }
 
-inline
-LocTimerDelegate* LocTimerContainer::getSoonestTimer() {
-    return (LocTimerDelegate*)(peek());
-}
-
 inline
 int LocTimerContainer::getTimerFd() {
     return mDevFd;
 }
 
-void LocTimerContainer::updateSoonestTime(LocTimerDelegate* priorTop) {
-    LocTimerDelegate* curTop = getSoonestTimer();
+void LocTimerContainer::updateSoonestTime() {
+    mDirty = false;
+    struct itimerspec delay = {0};
+    bool armed = mBackend->getNextTime(delay.it_value);
 
-    // check if top has changed
-    if (curTop != priorTop) {
-        struct itimerspec delay = {0};
-        bool toSetTime = false;
-        // if tree is empty now, we remove poll and disarm timer
-        if (!curTop) {
-            mPollTask->removePoll(*this);
-            // setting the values to disarm timer
-            delay.it_value.tv_sec = 0;
-            delay.it_value.tv_nsec = 0;
-            toSetTime = true;
-        } else if (!priorTop || curTop->outRanks(*priorTop)) {
+    // only call into the kernel when the soonest time has changed
+    if (delay.it_value.tv_sec != mArmedTime.tv_sec ||
+        delay.it_value.tv_nsec != mArmedTime.tv_nsec) {
+        if (armed) {
             // do this first to avoid race condition, in case settime is called
             // with too small an interval
             mPollTask->addPoll(*this);
-            delay.it_value = curTop->getFutureTime();
-            toSetTime = true;
-        }
-        if (toSetTime) {
-            timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+        } else {
+            // if backend is empty now, we remove poll and disarm timer
+            mPollTask->removePoll(*this);
         }
+        timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+        mArmedTime = delay.it_value;
+    }
+}
+
+void LocTimerContainer::addInline(LocTimerDelegate& timer) {
+    timer.mAddPending = false;
+    if (!mBackend->add(timer)) {
+        LOC_LOGE("%s: no memory to grow the timer heap", __FUNCTION__);
+    }
+    if (!mDirty) {
+        mDirty = true;
+        mPollTask->markDirty(*this);
+    }
+}
+
+void LocTimerContainer::removeInline(LocTimerDelegate& timer) {
+    // update soonest timer only if timer is actually removed from
+    // the backend, i.e. it has not expired already.
+    if (mBackend->remove(timer) && !mDirty) {
+        mDirty = true;
+        mPollTask->markDirty(*this);
     }
+    // all timers are deleted here, and only here.
+    delete &timer;
 }
 
-// all the heap management is done in the MsgTask context.
+// all the heap management is done in the MsgTask context. If the caller
+// is already in it, e.g. a timer callback restarting its timer, it is done
+// right away, without a msg.
 inline
 void LocTimerContainer::add(LocTimerDelegate& timer) {
-    struct MsgTimerPush : public LocMsg {
+    struct MsgTimerPush : public LocMsg, public LocPooled<MsgTimerPush, 16> {
         LocTimerContainer* mTimerContainer;
-        LocHeapNode* mTree;
         LocTimerDelegate* mTimer;
         inline MsgTimerPush(LocTimerContainer& container, LocTimerDelegate& timer) :
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
+        inline virtual const char* name() const { return "MsgTimerPush"; }
         inline virtual void proc() const {
-            LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-            mTimerContainer->push((LocRankable&)(*mTimer));
-            mTimerContainer->updateSoonestTime(priorTop);
+            mTimerContainer->addInline(*mTimer);
         }
     };
 
-    mMsgTask->sendMsg(new MsgTimerPush(*this, timer));
+    if (mPollTask->isPollThread()) {
+        addInline(timer);
+    } else {
+        timer.mAddPending = true;
+        mMsgTask->sendMsg(new MsgTimerPush(*this, timer));
+    }
 }
 
-// all the heap management is done in the MsgTask context.
+// all the heap management is done in the MsgTask context. A timer whose add
+// msg is still queued is removed by a msg too, so that it goes after it.
 void LocTimerContainer::remove(LocTimerDelegate& timer) {
-    struct MsgTimerRemove : public LocMsg {
+    struct MsgTimerRemove : public LocMsg, public LocPooled<MsgTimerRemove, 16> {
         LocTimerContainer* mTimerContainer;
         LocTimerDelegate* mTimer;
         inline MsgTimerRemove(LocTimerContainer& container, LocTimerDelegate& timer) :
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
+        inline virtual const char* name() const { return "MsgTimerRemove"; }
         inline virtual void proc() const {
-            LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-
-            // update soonest timer only if mTimer is actually removed from
-            // mTimerContainer AND mTimer is not priorTop.
-            if (priorTop == ((LocHeap*)mTimerContainer)->remove((LocRankable&)*mTimer)) {
-                // if passing in NULL, we tell updateSoonestTime to update
-                // kernel with the current top timer interval.
-                mTimerContainer->updateSoonestTime(NULL);
-            }
-            // all timers are deleted here, and only here.
-            delete mTimer;
+            mTimerContainer->removeInline(*mTimer);
         }
     };
 
-    mMsgTask->sendMsg(new MsgTimerRemove(*this, timer));
+    if (mPollTask->isPollThread() && !timer.mAddPending) {
+        removeInline(timer);
+    } else {
+        mMsgTask->sendMsg(new MsgTimerRemove(*this, timer));
+    }
 }
 
-// all the heap management is done in the MsgTask context.
-// Upon expire, we check and continuously pop the heap until
-// the top node's timeout is in the future.
+// Upon expire, we check and continuously pop the backend until the soonest
+// timeout is in the future. This is called by LocTimerPollTask, whose thread
+// is also the MsgTask context, so the backend is managed right here.
 void LocTimerContainer::expire() {
-    struct MsgTimerExpire : public LocMsg {
-        LocTimerContainer* mTimerContainer;
-        inline MsgTimerExpire(LocTimerContainer& container) :
-            LocMsg(), mTimerContainer(&container) {}
-        inline virtual void proc() const {
-            struct timespec now;
-            // get time spec of now
-            clock_gettime(CLOCK_BOOTTIME, &now);
-            LocTimerDelegate timerOfNow(now);
-            // pop everything in the heap that outRanks now, i.e. has time older than now
-            // and then call expire() on that timer.
-            for (LocTimerDelegate* timer = (LocTimerDelegate*)mTimerContainer->pop();
-                 NULL != timer;
-                 timer = mTimerContainer->popIfOutRanks(timerOfNow)) {
-                // the timer delegate obj will be deleted before the return of this call
-                timer->expire();
-            }
-            mTimerContainer->updateSoonestTime(NULL);
-        }
-    };
-
     struct itimerspec delay = {0};
     timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
     mPollTask->removePoll(*this);
-    mMsgTask->sendMsg(new MsgTimerExpire(*this));
+    memset(&mArmedTime, 0, sizeof(mArmedTime));
+
+    struct timespec now;
+    // get time spec of now
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    // pop everything in the backend that has time older than now
+    // and then call expire() on that timer.
+    uint64_t expired = 0;
+    for (LocTimerDelegate* timer = mBackend->popExpired(now);
+         NULL != timer;
+         timer = mBackend->popExpired(now)) {
+        // the timer delegate obj will be deleted before the return of this call
+        timer->expire();
+        expired++;
+    }
+    mWakeups++;
+    if (expired) {
+        mExpired += expired;
+        // all but one would have had a wakeup of their own without slack
+        mCoalesced += expired - 1;
+    }
+    updateSoonestTime();
 }
 
-LocTimerDelegate* LocTimerContainer::popIfOutRanks(LocTimerDelegate& timer) {
-    LocTimerDelegate* poppedNode = NULL;
-    if (mTree && !timer.outRanks(*peek())) {
-        poppedNode = (LocTimerDelegate*)(pop());
+
+void LocTimerContainer::onCallback(const struct timespec& deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    int64_t lateNs = (int64_t)(now.tv_sec - deadline.tv_sec) * 1000000000LL +
+        (now.tv_nsec - deadline.tv_nsec);
+    if (lateNs < 0) {
+        lateNs = 0;
+    }
+    uint64_t lateUs = lateNs / 1000;
+    uint32_t late = (lateUs > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)lateUs;
+
+    pthread_mutex_lock(&mLateMutex);
+    mLate.add(lateNs);
+    mLateSumSqUs += (double)lateUs * lateUs;
+    // insertion into the worst cases, kept latest first
+    uint32_t i = LOC_TIMER_WORST_CASES;
+    while (i > 0 && late > mWorstLateUs[i - 1]) {
+        if (i < LOC_TIMER_WORST_CASES) {
+            mWorstLateUs[i] = mWorstLateUs[i - 1];
+            mWorstDeadlineMs[i] = mWorstDeadlineMs[i - 1];
+        }
+        i--;
     }
+    if (i < LOC_TIMER_WORST_CASES) {
+        mWorstLateUs[i] = late;
+        mWorstDeadlineMs[i] = (uint64_t)deadline.tv_sec * 1000 + deadline.tv_nsec / 1000000;
+    }
+    pthread_mutex_unlock(&mLateMutex);
+}
 
-    return poppedNode;
+void LocTimerContainer::getStats(bool wakeOnExpire, LocTimerStats& stats) {
+    LocTimerContainer* container = wakeOnExpire ? mHwTimers : mSwTimers;
+    memset(&stats, 0, sizeof(stats));
+    if (container) {
+        stats.mWakeups = container->mWakeups.load();
+        stats.mExpired = container->mExpired.load();
+        stats.mCoalesced = container->mCoalesced.load();
+
+        pthread_mutex_lock(&container->mLateMutex);
+        const LocHistogram<LOC_TIMER_LATE_BUCKETS>& late = container->mLate;
+        uint64_t count = late.getCount();
+        if (count) {
+            double avg = (double)late.mSumUs / count;
+            double variance = container->mLateSumSqUs / count - avg * avg;
+            stats.mLateAvgUs = late.mSumUs / count;
+            stats.mLateP50Us = late.percentile(count, 50);
+            stats.mLateP90Us = late.percentile(count, 90);
+            stats.mLateP99Us = late.percentile(count, 99);
+            stats.mLateMaxUs = late.mMaxUs;
+            stats.mJitterUs = (variance > 0) ? (uint32_t)sqrt(variance) : 0;
+        }
+        memcpy(stats.mWorstLateUs, container->mWorstLateUs, sizeof(stats.mWorstLateUs));
+        memcpy(stats.mWorstDeadlineMs, container->mWorstDeadlineMs,
+               sizeof(stats.mWorstDeadlineMs));
+        pthread_mutex_unlock(&container->mLateMutex);
+    }
 }
 
+void LocTimerContainer::dumpStats() {
+    for (int wakeOnExpire = 0; wakeOnExpire < 2; wakeOnExpire++) {
+        const char* name = wakeOnExpire ? "alarms" : "timers";
+        LocTimerStats stats;
+        getStats(wakeOnExpire, stats);
+        LOC_LOGI("LocTimer %s: wakeups %llu expired %llu coalesced %llu"
+                 " late us avg %llu p50 %u p90 %u p99 %u max %u jitter %u\n",
+                 name, (unsigned long long)stats.mWakeups,
+                 (unsigned long long)stats.mExpired, (unsigned long long)stats.mCoalesced,
+                 (unsigned long long)stats.mLateAvgUs, stats.mLateP50Us, stats.mLateP90Us,
+                 stats.mLateP99Us, stats.mLateMaxUs, stats.mJitterUs);
+        for (uint32_t i = 0; i < LOC_TIMER_WORST_CASES && stats.mWorstLateUs[i]; i++) {
+            LOC_LOGI("LocTimer %s: worst #%u late %u us, deadline at %llu ms\n",
+                     name, i + 1, stats.mWorstLateUs[i],
+                     (unsigned long long)stats.mWorstDeadlineMs[i]);
+        }
+    }
+}
 
 /***************************LocTimerPollTask methods***************************/
 
 inline
-LocTimerPollTask::LocTimerPollTask()
-    : mFd(epoll_create(2)), mThread(new LocThread()) {
+LocTimerPollTask::LocTimerPollTask(MsgTask& msgTask)
+    : mFd(epoll_create(3)), mMsgTask(&msgTask), mThread(new LocThread()),
+      mPollThread(0), mRunning(false), mNumDirty(0) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = mMsgTask;
+    epoll_ctl(mFd, EPOLL_CTL_ADD, mMsgTask->getFd(), &ev);
+
     // before a next call returens, a thread will be created. The run() method
     // could already be running in parallel. Also, since each of the objs
     // creates a thread, the container will make sure that there will be only
@@ -441,28 +944,41 @@ void LocTimerPollTask::removePoll(LocTimerContainer& timerContainer) {
     epoll_ctl(mFd, EPOLL_CTL_DEL, timerContainer.getTimerFd(), NULL);
 }
 
+void LocTimerPollTask::prerun() {
+    mPollThread = pthread_self();
+    mRunning.store(true);
+}
+
 // The polling thread context will call this method. If run() method needs to
 // be repetitvely called, it must return true from the previous call.
 bool LocTimerPollTask::run() {
-    struct epoll_event ev[2];
+    struct epoll_event ev[3];
 
-    // we have max 2 descriptors to poll from
-    int fds = epoll_wait(mFd, ev, 2, -1);
+    // we have max 3 descriptors to poll from, timer, alarm and MsgTask
+    int fds = epoll_wait(mFd, ev, 3, -1);
 
     // we pretty much want to continually poll until the fd is closed
     bool rerun = (fds > 0) || (errno == EINTR);
 
     if (fds > 0) {
-        // we may have 2 events
+        // we may have 3 events
         for (int i = 0; i < fds; i++) {
-            // each fd has a context pointer associated with the right timer container
+            // each fd has a context pointer associated with the right timer
+            // container, or with the MsgTask
             LocTimerContainer* container = (LocTimerContainer*)(ev[i].data.ptr);
-            if (container) {
+            if (ev[i].data.ptr == mMsgTask) {
+                mMsgTask->drain();
+            } else if (container) {
                 container->expire();
             } else {
                 epoll_ctl(mFd, EPOLL_CTL_DEL, ev[i].data.fd, NULL);
             }
         }
+        // a burst of start() / stop() costs one timerfd update, if any
+        for (uint32_t i = 0; i < mNumDirty; i++) {
+            mDirty[i]->updateIfDirty();
+        }
+        mNumDirty = 0;
     }
 
     // if rerun is true, we are requesting to be scheduled again
@@ -472,11 +988,16 @@ bool LocTimerPollTask::run() {
 /***************************LocTimerDelegate methods***************************/
 
 inline
-LocTimerDelegate::LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire)
+LocTimerDelegate::LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire,
+                                   uint32_t slackInMs, uint32_t periodInMs)
     : mClient(&client),
       mLock(mClient->mLock->share()),
       mFutureTime(futureTime),
-      mContainer(LocTimerContainer::get(wakeOnExpire)) {
+      mLatestTime(futureTime),
+      mContainer(LocTimerContainer::get(wakeOnExpire)),
+      mPeriodInMs(periodInMs),
+      mAddPending(false) {
+    addMs(mLatestTime, slackInMs);
     // adding the timer into the container
     mContainer->add(*this);
 }
@@ -506,18 +1027,55 @@ int LocTimerDelegate::ranks(LocRankable& rankable) {
     if (timer) {
         // larger time ranks lower!!!
         // IOW, if input obj has bigger tv_sec/tv_nsec, this obj outRanks higher
-        rank = timer->mFutureTime.tv_sec - mFutureTime.tv_sec;
+        // Ranked by the latest time, i.e. time out plus slack
+        rank = timer->mLatestTime.tv_sec - mLatestTime.tv_sec;
         if(0 == rank)
         {
             //rank against tv_nsec for msec accuracy
-            rank = (int)(timer->mFutureTime.tv_nsec - mFutureTime.tv_nsec);
+            rank = (int)(timer->mLatestTime.tv_nsec - mLatestTime.tv_nsec);
         }
     }
     return rank;
 }
 
+// MsgTask context only, the same as the container it is put back into
+bool LocTimerDelegate::rearm() {
+    bool rearmed = false;
+    mLock->lock();
+    // mClient is NULL'ed, and the remove msg sent, under the same lock
+    if (mClient && mContainer) {
+        struct timespec now;
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        // from the previous deadline, skipping the periods already past
+        do {
+            addMs(mFutureTime, mPeriodInMs);
+            addMs(mLatestTime, mPeriodInMs);
+        } while (isNotAfter(mFutureTime, now));
+        mContainer->readd(*this);
+        mClient->onRearm();
+        rearmed = true;
+    }
+    mLock->unlock();
+    return rearmed;
+}
+
 inline
 void LocTimerDelegate::expire() {
+    // the deadline missed by, before rearm() moves it, or stop() deletes
+    // *this*
+    struct timespec deadline = mFutureTime;
+    LocTimerContainer* container = mContainer;
+    if (mPeriodInMs) {
+        // keeping a copy of client pointer, as the client may stop(), and
+        // have *this* deleted, as soon as we are back in the container
+        LocTimer* client = mClient;
+        if (rearm()) {
+            container->onCallback(deadline);
+            client->timeOutCallback();
+        }
+        return;
+    }
+
     // keeping a copy of client pointer to be safe
     // when timeOutCallback() is called at the end of this
     // method, *this* obj may be already deleted.
@@ -527,6 +1085,7 @@ void LocTimerDelegate::expire() {
         // calling client callback with a pointer save on the stack
         // only if stop() returns true, i.e. it hasn't been stopped
         // already.
+        container->onCallback(deadline);
         client->timeOutCallback();
     }
 }
@@ -545,18 +1104,28 @@ LocTimer::~LocTimer() {
 }
 
 bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
+    return start(timeOutInMs, wakeOnExpire, 0);
+}
+
+bool LocTimer::start(uint32_t timeOutInMs, bool wakeOnExpire, uint32_t slackInMs) {
+    return startDelegate(timeOutInMs, wakeOnExpire, slackInMs, 0);
+}
+
+bool LocTimer::startPeriodic(uint32_t periodInMs, bool wakeOnExpire, uint32_t slackInMs) {
+    // a 0 period would go off forever without ever returning to the poll
+    return (0 != periodInMs) &&
+        startDelegate(periodInMs, wakeOnExpire, slackInMs, periodInMs);
+}
+
+bool LocTimer::startDelegate(uint32_t timeOutInMs, bool wakeOnExpire,
+                             uint32_t slackInMs, uint32_t periodInMs) {
     bool success = false;
     mLock->lock();
     if (!mTimer) {
         struct timespec futureTime;
         clock_gettime(CLOCK_BOOTTIME, &futureTime);
-        futureTime.tv_sec += timeOutInMs / 1000;
-        futureTime.tv_nsec += (timeOutInMs % 1000) * 1000000;
-        if (futureTime.tv_nsec >= 1000000000) {
-            futureTime.tv_sec += futureTime.tv_nsec / 1000000000;
-            futureTime.tv_nsec %= 1000000000;
-        }
-        mTimer = new LocTimerDelegate(*this, futureTime, wakeOnExpire);
+        addMs(futureTime, timeOutInMs);
+        mTimer = new LocTimerDelegate(*this, futureTime, wakeOnExpire, slackInMs, periodInMs);
         // if mTimer is non 0, success should be 0; or vice versa
         success = (NULL != mTimer);
     }
@@ -564,6 +1133,14 @@ bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
     return success;
 }
 
+void LocTimer::getStats(bool wakeOnExpire, LocTimerStats& stats) {
+    LocTimerContainer::getStats(wakeOnExpire, stats);
+}
+
+void LocTimer::dumpStats() {
+    LocTimerContainer::dumpStats();
+}
+
 bool LocTimer::stop() {
     bool success = false;
     mLock->lock();
@@ -587,26 +1164,54 @@ class LocTimerWrapper : public LocTimer {
     loc_timer_callback mCb;
     void* mCallerData;
     LocTimerWrapper* mMe;
+    // a periodic wrapper lives until loc_timer_stop()
+    const bool mPeriodic;
+    // a periodic callback is pending or running, and destroy() has to
+    // leave the delete to it. Set by onRearm(), under the timer lock,
+    // cleared under mMutex; both on the MsgTask thread.
+    bool mInCallback;
+    // destroy() was called while mInCallback
+    bool mDestroyPending;
     static pthread_mutex_t mMutex;
     inline ~LocTimerWrapper() { mCb = NULL; mMe = NULL; }
+protected:
+    inline virtual void onRearm() { mInCallback = true; }
 public:
-    inline LocTimerWrapper(loc_timer_callback cb, void* callerData) :
-        mCb(cb), mCallerData(callerData), mMe(this) {
+    inline LocTimerWrapper(loc_timer_callback cb, void* callerData, bool periodic = false) :
+        mCb(cb), mCallerData(callerData), mMe(this), mPeriodic(periodic),
+        mInCallback(false), mDestroyPending(false) {
     }
     void destroy() {
         pthread_mutex_lock(&mMutex);
-        if (NULL != mCb && this == mMe) {
-            delete this;
+        if (NULL != mCb && this == mMe && !mDestroyPending) {
+            // once stop() returns, no more callbacks are pending, other
+            // than one onRearm() has flagged already
+            stop();
+            if (mInCallback) {
+                mDestroyPending = true;
+            } else {
+                delete this;
+            }
         }
         pthread_mutex_unlock(&mMutex);
     }
     virtual void timeOutCallback() {
         loc_timer_callback cb = mCb;
         void* callerData = mCallerData;
+        bool periodic = mPeriodic;
         if (cb) {
             cb(callerData, 0);
         }
-        destroy();
+        if (!periodic) {
+            destroy();
+        } else {
+            pthread_mutex_lock(&mMutex);
+            mInCallback = false;
+            if (mDestroyPending) {
+                delete this;
+            }
+            pthread_mutex_unlock(&mMutex);
+        }
     }
 };
 
@@ -628,6 +1233,23 @@ void* loc_timer_start(uint64_t msec, loc_timer_callback cb_func,
     return locTimerWrapper;
 }
 
+void* loc_timer_start_periodic(uint64_t period_msec, loc_timer_callback cb_func,
+                               void *caller_data, bool wake_on_expire)
+{
+    LocTimerWrapper* locTimerWrapper = NULL;
+
+    if (cb_func) {
+        locTimerWrapper = new LocTimerWrapper(cb_func, caller_data, true);
+
+        if (locTimerWrapper && !locTimerWrapper->startPeriodic(period_msec, wake_on_expire)) {
+            locTimerWrapper->destroy();
+            locTimerWrapper = NULL;
+        }
+    }
+
+    return locTimerWrapper;
+}
+
 void loc_timer_stop(void*&  handle)
 {
     if (handle) {
@@ -682,12 +1304,239 @@ public:
     }
 };
 
+// N concurrent timers spread over a window, each recording how late its
+// callback comes, optionally spinning workUs in the callback as load.
+// The deadline is taken just before start(), so it may be up to a few us
+// earlier than the one the container computes.
+class LocTimerLateTest : public LocTimer {
+    struct timespec mDeadline;
+public:
+    static std::atomic<int> sPending;
+    static uint32_t sWorkUs;
+    int64_t mLateUs;
+    inline LocTimerLateTest() : mLateUs(-1) {}
+    inline void start(uint32_t timeOutInMs) {
+        mDeadline = getNow();
+        addMs(mDeadline, timeOutInMs);
+        LocTimer::start(timeOutInMs, false);
+    }
+    inline virtual void timeOutCallback() {
+        struct timespec now = getNow();
+        mLateUs = (int64_t)(getDeltaSeconds(mDeadline, now) * 1000000);
+        while (getDeltaSeconds(now, getNow()) * 1000000 < sWorkUs) {
+        }
+        sPending--;
+    }
+};
+std::atomic<int> LocTimerLateTest::sPending(0);
+uint32_t LocTimerLateTest::sWorkUs = 0;
+
+static int compareLate(const void* a, const void* b) {
+    int64_t d = *(const int64_t*)a - *(const int64_t*)b;
+    return (d > 0) - (d < 0);
+}
+
+static void lateness(int timers, uint32_t spreadMs, uint32_t workUs) {
+    LocTimerLateTest* tests = new LocTimerLateTest[timers];
+    LocTimerLateTest::sWorkUs = workUs;
+    LocTimerLateTest::sPending = timers;
+    for (int i = 0; i < timers; i++) {
+        tests[i].start(spreadMs ? rand() % spreadMs : 0);
+    }
+    while (LocTimerLateTest::sPending > 0) {
+        usleep(10000);
+    }
+
+    int64_t* late = new int64_t[timers];
+    for (int i = 0; i < timers; i++) {
+        late[i] = tests[i].mLateUs;
+    }
+    qsort(late, timers, sizeof(late[0]), compareLate);
+    printf("%d timers over %u ms, %u us of work each, late us:"
+           " min %lld p50 %lld p90 %lld p99 %lld p99.9 %lld max %lld\n",
+           timers, spreadMs, workUs, (long long)late[0],
+           (long long)late[timers * 50 / 100], (long long)late[timers * 90 / 100],
+           (long long)late[timers * 99 / 100], (long long)late[timers * 999 / 1000],
+           (long long)late[timers - 1]);
+
+    LocTimerStats stats;
+    LocTimer::getStats(false, stats);
+    printf("container: wakeups %llu expired %llu late us avg %llu p50 <= %u p90 <= %u"
+           " p99 <= %u max %u jitter %u\n",
+           (unsigned long long)stats.mWakeups, (unsigned long long)stats.mExpired,
+           (unsigned long long)stats.mLateAvgUs, stats.mLateP50Us, stats.mLateP90Us,
+           stats.mLateP99Us, stats.mLateMaxUs, stats.mJitterUs);
+    delete[] late;
+    delete[] tests;
+}
+
+// start() / stop() throughput, both from a client thread and, from within
+// a timer callback, on the timer thread itself
+class LocTimerBench : public LocTimer {
+public:
+    int mPairs;
+    double mSeconds;
+    volatile bool mDone;
+    inline LocTimerBench(int pairs) : mPairs(pairs), mSeconds(0), mDone(false) {}
+    static double run(int pairs) {
+        LocTimerBench dummy(0);
+        struct timespec from = getNow();
+        for (int i = 0; i < pairs; i++) {
+            dummy.start(60000, false);
+            dummy.stop();
+        }
+        return getDeltaSeconds(from, getNow());
+    }
+    inline virtual void timeOutCallback() {
+        mSeconds = run(mPairs);
+        mDone = true;
+    }
+};
+
+// goes off once everything the timer thread was given before it is done
+class LocTimerBenchEnd : public LocTimer {
+public:
+    volatile bool mDone;
+    inline LocTimerBenchEnd() : mDone(false) {}
+    inline virtual void timeOutCallback() { mDone = true; }
+    // seconds until the timer thread is done with all it was given so far
+    static double drain() {
+        LocTimerBenchEnd end;
+        struct timespec from = getNow();
+        end.start(0, false);
+        while (!end.mDone) {
+            usleep(100);
+        }
+        return getDeltaSeconds(from, getNow());
+    }
+};
+
+static void benchmark(int pairs) {
+    double seconds = LocTimerBench::run(pairs);
+    double drained = LocTimerBenchEnd::drain();
+    printf("client thread: %d start / stop pairs in %lf + %lf sec, %.0f pairs / sec\n",
+           pairs, seconds, drained, pairs / (seconds + drained));
+    LocTimerBench bench(pairs);
+    bench.start(0, false);
+    while (!bench.mDone) {
+        usleep(100);
+    }
+    drained = LocTimerBenchEnd::drain();
+    printf("timer thread:  %d start / stop pairs in %lf + %lf sec, %.0f pairs / sec\n",
+           pairs, bench.mSeconds, drained, pairs / (bench.mSeconds + drained));
+}
+
+// threads contending on one lock, each taking it iterations times around
+// a tiny critical section, as LocTimer::start() / stop() / expire() do
+template <typename LOCK>
+class LocLockBench {
+    LOCK& mLock;
+    const int mIterations;
+    volatile uint64_t mCounter;
+    static void* run(void* arg) {
+        LocLockBench* bench = (LocLockBench*)arg;
+        for (int i = 0; i < bench->mIterations; i++) {
+            bench->mLock.lock();
+            bench->mCounter++;
+            bench->mLock.unlock();
+        }
+        return NULL;
+    }
+public:
+    inline LocLockBench(LOCK& lock, int iterations) :
+        mLock(lock), mIterations(iterations), mCounter(0) {}
+    void measure(const char* name, int threads) {
+        pthread_t* ids = new pthread_t[threads];
+        struct timespec from = getNow();
+        for (int i = 0; i < threads; i++) {
+            pthread_create(&ids[i], NULL, run, this);
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(ids[i], NULL);
+        }
+        double seconds = getDeltaSeconds(from, getNow());
+        printf("%-16s %d threads: %llu lock / unlock in %lf sec, %.0f ns each%s\n",
+               name, threads, (unsigned long long)mCounter, seconds,
+               seconds * 1000000000 / mCounter,
+               ((uint64_t)threads * mIterations == mCounter) ? "" : " COUNT MISMATCH");
+        delete[] ids;
+    }
+};
+
+class LocPthreadLock {
+    pthread_mutex_t mMutex;
+public:
+    inline LocPthreadLock() { pthread_mutex_init(&mMutex, NULL); }
+    inline ~LocPthreadLock() { pthread_mutex_destroy(&mMutex); }
+    inline void lock() { pthread_mutex_lock(&mMutex); }
+    inline void unlock() { pthread_mutex_unlock(&mMutex); }
+};
+
+static void lockBenchmark(int threads, int iterations) {
+    for (int n = 1; n <= threads; n *= 2) {
+        LocPthreadLock mutex;
+        LocLockBench<LocPthreadLock>(mutex, iterations).measure("pthread_mutex_t", n);
+        LocSharedLock* shared = new LocSharedLock();
+        LocLockBench<LocSharedLock>(*shared, iterations).measure("LocSharedLock", n);
+        shared->drop();
+    }
+}
+
 // For Linux command line testing:
+// benchmark: ./LocTimer.o bench 1000000
+// lateness:  ./LocTimer.o late <timers> <spread ms> [callback work us]
+// locking:   ./LocTimer.o lock <max threads> <iterations per thread>
+// periodic loc_timer_start_periodic() timers stopped from another thread
+// at varying points of their period, and one stopped from its own
+// callback. Run it under valgrind / ASan: the callback must never run on
+// a stopped and deleted wrapper.
+static std::atomic<int> sPeriodicCalls(0);
+static void periodicStopCb(void* /*data*/, int /*result*/) {
+    sPeriodicCalls++;
+    // some work, so stops land inside the callback too
+    volatile int work = 0;
+    for (int i = 0; i < 20000; i++) {
+        work += i;
+    }
+}
+static void periodicSelfStopCb(void* data, int /*result*/) {
+    sPeriodicCalls++;
+    loc_timer_stop(*(void**)data);
+}
+void periodicStop(int rounds) {
+    for (int i = 0; i < rounds; i++) {
+        void* handle = loc_timer_start_periodic(1, periodicStopCb, NULL, false);
+        usleep(1000 + (i % 7) * 150);
+        loc_timer_stop(handle);
+    }
+    void* self = NULL;
+    self = loc_timer_start_periodic(1, periodicSelfStopCb, &self, false);
+    usleep(20000);
+    printf("%d rounds, %d callbacks, self stopped %s\n", rounds,
+           sPeriodicCalls.load(), (NULL == self) ? "yes" : "no");
+}
+
 // compilation:
 //     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. -I../../../../system/core/include -o LocHeap.o LocHeap.cpp
 //     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -std=c++0x -I. -I../../../../system/core/include -lpthread -o LocThread.o LocThread.cpp
 //     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. -I../../../../system/core/include -o LocTimer.o LocTimer.cpp
 int main(int argc, char** argv) {
+    if (argc > 2 && 0 == strcmp(argv[1], "bench")) {
+        benchmark(atoi(argv[2]));
+        return 0;
+    }
+    if (argc > 3 && 0 == strcmp(argv[1], "lock")) {
+        lockBenchmark(atoi(argv[2]), atoi(argv[3]));
+        return 0;
+    }
+    if (argc > 2 && 0 == strcmp(argv[1], "periodic_stop")) {
+        periodicStop(atoi(argv[2]));
+        return 0;
+    }
+    if (argc > 3 && 0 == strcmp(argv[1], "late")) {
+        lateness(atoi(argv[2]), atoi(argv[3]), (argc > 4) ? atoi(argv[4]) : 0);
+        return 0;
+    }
     struct timespec timeOfStart=getNow();
     srand(time(NULL));
     int tries = atoi(argv[1]);
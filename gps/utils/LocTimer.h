@@ -31,12 +31,40 @@
 #define __LOC_TIMER_CPP_H__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <log_util.h>
 
 // opaque class to provide service implementation.
 class LocTimerDelegate;
 class LocSharedLock;
 
+// number of worst timeOutCallback() latenesses kept
+#define LOC_TIMER_WORST_CASES 4
+
+// counters of the timers, or of the alarms, of the process
+struct LocTimerStats {
+    // number of times the kernel timer went off
+    uint64_t mWakeups;
+    // number of timers that expired
+    uint64_t mExpired;
+    // number of timers that expired on the same wakeup as another timer,
+    // e.g. within their slack, i.e. the wakeups saved
+    uint64_t mCoalesced;
+    // how late timeOutCallback() calls were past their deadline, in us,
+    // from the deadline to the start of the callback. Includes the slack
+    // timers were started with. Percentiles are log2 bucket upper bounds.
+    uint64_t mLateAvgUs;
+    uint32_t mLateP50Us;
+    uint32_t mLateP90Us;
+    uint32_t mLateP99Us;
+    uint32_t mLateMaxUs;
+    // standard deviation of the above
+    uint32_t mJitterUs;
+    // the worst cases, latest first, and their deadlines in ms since boot
+    uint32_t mWorstLateUs[LOC_TIMER_WORST_CASES];
+    uint64_t mWorstDeadlineMs[LOC_TIMER_WORST_CASES];
+};
+
 // LocTimer client must extend this class and implementthe callback.
 // start() / stop() methods are to arm / disarm timer.
 class LocTimer
@@ -47,6 +75,8 @@ class LocTimer
     // has to have a reference to the lock so that the delete of LocTimer
     // and LocTimerDelegate can work together on their share resources.
     friend class LocTimerDelegate;
+    bool startDelegate(uint32_t timeOutInMs, bool wakeOnExpire,
+                       uint32_t slackInMs, uint32_t periodInMs);
 
 public:
     LocTimer();
@@ -61,6 +91,19 @@ public:
     //               false on failure, e.g. timer is already running.
     bool start(uint32_t timeOutInMs, bool wakeOnExpire);
 
+    // same as above, except that the timer may go off anywhere up to
+    // slackInMs after timeOutInMs. Timers whose windows overlap are then
+    // served with a single wakeup.
+    bool start(uint32_t timeOutInMs, bool wakeOnExpire, uint32_t slackInMs);
+
+    // starts a timer that goes off every periodInMs, until stop() is called.
+    // Each period is counted from the previous deadline, not from when the
+    // callback ran, so there is no drift; periods missed altogether, e.g.
+    // while suspended, are skipped. Nothing is allocated per period.
+    // return:       true on success;
+    //               false on failure, e.g. timer is already running.
+    bool startPeriodic(uint32_t periodInMs, bool wakeOnExpire, uint32_t slackInMs = 0);
+
     // return:       true on success;
     //               false on failure, e.g. timer is not running.
     bool stop();
@@ -69,6 +112,21 @@ public:
     //  This method is used for timeout calling back to client. This method
     //  should be short enough (eg: send a message to your own thread).
     virtual void timeOutCallback() = 0;
+
+    // snapshot of the counters of the timers (wakeOnExpire false) or of
+    // the alarms (wakeOnExpire true). All 0 if none was ever started.
+    static void getStats(bool wakeOnExpire, LocTimerStats& stats);
+
+    // logs the stats of both the timers and the alarms
+    static void dumpStats();
+
+protected:
+    // called when a periodic timer is put back for its next period, and
+    // its timeOutCallback() is about to be called. Called with the timer
+    // lock held, so a stop() that returns before this call keeps the
+    // callback from being called at all; a stop() that returns after it
+    // does not. For clients that delete themselves on stop.
+    inline virtual void onRearm() {}
 };
 
 #endif //__LOC_DELAY_H__
@@ -30,40 +30,501 @@
 #define LOG_TAG "LocSvc_MsgTask"
 
 #include <cutils/sched_policy.h>
+#include <cutils/properties.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <atomic>
 #include <MsgTask.h>
 #include <msg_q.h>
+#include <linked_list.h>
 #include <log_util.h>
 #include <loc_log.h>
+#include <LocHistogram.h>
+
+// log2 us buckets, the last one takes all from ~0.5 sec up
+#define MSG_TASK_STATS_BUCKETS 21
+// msg types tracked per MsgTask; the rest are all counted as "other"
+#define MSG_TASK_STATS_TYPES 32
+#define MSG_TASK_DUMP_POLL_NS 1000000000ULL
+
+static inline uint64_t LocMsgNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+typedef LocHistogram<MSG_TASK_STATS_BUCKETS> LocMsgHistogram;
+
+struct LocMsgTypeStats {
+    const char* mName;
+    uint64_t mCount;
+    LocMsgHistogram mWait;
+    LocMsgHistogram mProc;
+};
+
+// Everything an instrumented MsgTask keeps. Senders only touch the atomic
+// depth counters; the type stats are updated by the MsgTask thread and
+// read by dumpStats() from any thread, under mMutex.
+class MsgTaskStats {
+public:
+    const MsgTask* mTask;
+    char mName[16];
+    std::atomic<uint32_t> mDepth;
+    std::atomic<uint32_t> mPeak;
+    pthread_mutex_t mMutex;
+    uint32_t mNumTypes;
+    LocMsgTypeStats mTypes[MSG_TASK_STATS_TYPES + 1];
+    uint64_t mNextPollNs;
+    char mLastDump[PROPERTY_VALUE_MAX];
+    MsgTaskStats* mNext;
+
+    static pthread_mutex_t sListMutex;
+    static MsgTaskStats* sList;
+
+    MsgTaskStats(const MsgTask* task, const char* name);
+    ~MsgTaskStats();
+
+    inline void onSend(const LocMsg* msg) {
+        msg->mSentNs = LocMsgNowNs();
+        uint32_t depth = ++mDepth;
+        uint32_t peak = mPeak.load(std::memory_order_relaxed);
+        while (depth > peak && !mPeak.compare_exchange_weak(peak, depth)) {
+        }
+    }
+    // a msg that was sent but will not be proc()'ed
+    inline void onDrop() { --mDepth; }
+    void onProc(const LocMsg* msg, uint64_t startNs, uint64_t endNs);
+    LocMsgTypeStats& typeStats(const char* name);
+    bool pollDump(uint64_t nowNs);
+    void dump();
+};
+
+pthread_mutex_t MsgTaskStats::sListMutex = PTHREAD_MUTEX_INITIALIZER;
+MsgTaskStats* MsgTaskStats::sList = NULL;
+
+MsgTaskStats::MsgTaskStats(const MsgTask* task, const char* name) :
+    mTask(task), mDepth(0), mPeak(0), mNumTypes(0), mNextPollNs(0), mNext(NULL) {
+    strlcpy(mName, name ? name : "MsgTask", sizeof(mName));
+    memset(mTypes, 0, sizeof(mTypes));
+    mTypes[MSG_TASK_STATS_TYPES].mName = "other";
+    property_get(MSG_TASK_DUMP_PROP, mLastDump, "");
+    pthread_mutex_init(&mMutex, NULL);
+
+    pthread_mutex_lock(&sListMutex);
+    mNext = sList;
+    sList = this;
+    pthread_mutex_unlock(&sListMutex);
+}
+
+MsgTaskStats::~MsgTaskStats() {
+    pthread_mutex_lock(&sListMutex);
+    MsgTaskStats** pp = &sList;
+    while (*pp && *pp != this) {
+        pp = &(*pp)->mNext;
+    }
+    if (*pp) {
+        *pp = mNext;
+    }
+    pthread_mutex_unlock(&sListMutex);
+    pthread_mutex_destroy(&mMutex);
+}
+
+// msg names are string literals, so the pointer is the key. Only a
+// handful of types go through a MsgTask, a linear scan is all it takes.
+LocMsgTypeStats& MsgTaskStats::typeStats(const char* name) {
+    for (uint32_t i = 0; i < mNumTypes; i++) {
+        if (mTypes[i].mName == name) {
+            return mTypes[i];
+        }
+    }
+    if (mNumTypes < MSG_TASK_STATS_TYPES) {
+        mTypes[mNumTypes].mName = name;
+        return mTypes[mNumTypes++];
+    }
+    return mTypes[MSG_TASK_STATS_TYPES];
+}
+
+void MsgTaskStats::onProc(const LocMsg* msg, uint64_t startNs, uint64_t endNs) {
+    --mDepth;
+    pthread_mutex_lock(&mMutex);
+    LocMsgTypeStats& type = typeStats(msg->name());
+    type.mCount++;
+    // a msg not stamped by sendMsg(), e.g. one sent before the stats
+    // were there, only counts towards proc() time
+    if (msg->mSentNs && startNs >= msg->mSentNs) {
+        type.mWait.add(startNs - msg->mSentNs);
+    }
+    type.mProc.add(endNs - startNs);
+    bool dumpNow = pollDump(endNs);
+    pthread_mutex_unlock(&mMutex);
+    if (dumpNow) {
+        dump();
+    }
+}
+
+// under mMutex, as the workers of a pooled MsgTask may all get here;
+// returns true if MSG_TASK_DUMP_PROP has a new value
+bool MsgTaskStats::pollDump(uint64_t nowNs) {
+    if (nowNs >= mNextPollNs) {
+        mNextPollNs = nowNs + MSG_TASK_DUMP_POLL_NS;
+        char value[PROPERTY_VALUE_MAX];
+        property_get(MSG_TASK_DUMP_PROP, value, "");
+        if (0 != strcmp(value, mLastDump)) {
+            strlcpy(mLastDump, value, sizeof(mLastDump));
+            return true;
+        }
+    }
+    return false;
+}
+
+void MsgTaskStats::dump() {
+    msg_q_stats_type qStats;
+    uint32_t depth = mDepth.load();
+    uint32_t peak = mPeak.load();
+    // msg_q knows better, as it also sees the msgs it drops
+    if (mTask->getStats(qStats)) {
+        depth = qStats.size;
+        peak = qStats.high_water;
+    }
+    LOC_LOGI("MsgTask %s: depth %u peak %u\n", mName, depth, peak);
+
+    pthread_mutex_lock(&mMutex);
+    for (uint32_t i = 0; i <= MSG_TASK_STATS_TYPES; i++) {
+        const LocMsgTypeStats& type = mTypes[i];
+        if (0 == type.mCount) {
+            continue;
+        }
+        uint64_t waited = type.mWait.getCount();
+        LOC_LOGI("MsgTask %s: %s n %llu wait us avg %llu p50 %u p99 %u max %u"
+                 " proc us avg %llu p50 %u p99 %u max %u\n",
+                 mName, type.mName, (unsigned long long)type.mCount,
+                 (unsigned long long)(waited ? type.mWait.mSumUs / waited : 0),
+                 type.mWait.percentile(waited, 50), type.mWait.percentile(waited, 99),
+                 type.mWait.mMaxUs,
+                 (unsigned long long)(type.mProc.mSumUs / type.mCount),
+                 type.mProc.percentile(type.mCount, 50),
+                 type.mProc.percentile(type.mCount, 99),
+                 type.mProc.mMaxUs);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+static MsgTaskStats* LocMsgStatsInit(const MsgTask* task, const char* threadName,
+                                     const MsgTaskConfig& config) {
+    bool instrument = config.mInstrument;
+    if (!instrument) {
+        char value[PROPERTY_VALUE_MAX];
+        property_get(MSG_TASK_INSTRUMENT_PROP, value, "0");
+        instrument = (1 == atoi(value));
+    }
+    return instrument ? new MsgTaskStats(task, threadName) : NULL;
+}
 
 static void LocMsgDestroy(void* msg) {
     delete (LocMsg*)msg;
 }
 
+static inline bool LocMsgPooled(const MsgTaskConfig& config) {
+    return config.mWorkers > 1 && !config.mPollable;
+}
+
+static inline bool LocMsgLockFree(const MsgTaskConfig& config) {
+    return (config.mLockFree || config.mPollable) && !LocMsgPooled(config);
+}
+
+// A FIFO of msgs of one LocMsg::serialKey() (or of all the keys that map
+// to the same slot) of a pooled MsgTask.
+struct MsgTaskKeyQ {
+    // list of LocMsg's, oldest first
+    void* mMsgs;
+    // true while a worker proc()'es a msg of this FIFO
+    bool mActive;
+    // true while in the ready list of the pool
+    bool mReady;
+    MsgTaskKeyQ* mNextReady;
+};
+
+// serialKey()s are mapped onto this many FIFOs; keys that collide share
+// one, which keeps them in order, just not in parallel.
+#define MSG_TASK_POOL_KEYS 16
+
+// The shared state of the workers of a pooled MsgTask, all under mMutex.
+// A FIFO that has msgs, and none of them is being proc()'ed, is in the
+// ready list. A worker takes the first ready FIFO, proc()'es its oldest
+// msg and, if there are more, puts the FIFO back at the end of the list,
+// so that busy keys take turns and no key runs on two workers at once.
+class MsgTaskPool {
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    MsgTaskKeyQ mKeyQs[MSG_TASK_POOL_KEYS];
+    MsgTaskKeyQ* mReadyHead;
+    MsgTaskKeyQ* mReadyTail;
+    bool mStopped;
+
+    inline void makeReady(MsgTaskKeyQ& keyQ) {
+        keyQ.mReady = true;
+        keyQ.mNextReady = NULL;
+        if (mReadyTail) {
+            mReadyTail->mNextReady = &keyQ;
+        } else {
+            mReadyHead = &keyQ;
+        }
+        mReadyTail = &keyQ;
+        pthread_cond_signal(&mCond);
+    }
+
+public:
+    LocThread* mThreads;
+    const uint32_t mNumThreads;
+
+    MsgTaskPool(uint32_t workers) :
+        mReadyHead(NULL), mReadyTail(NULL), mStopped(false),
+        mThreads(new LocThread[workers]), mNumThreads(workers) {
+        pthread_mutex_init(&mMutex, NULL);
+        pthread_cond_init(&mCond, NULL);
+        memset(mKeyQs, 0, sizeof(mKeyQs));
+        for (uint32_t i = 0; i < MSG_TASK_POOL_KEYS; i++) {
+            linked_list_init(&mKeyQs[i].mMsgs);
+        }
+    }
+    // the threads must be all gone by now
+    ~MsgTaskPool() {
+        delete[] mThreads;
+        for (uint32_t i = 0; i < MSG_TASK_POOL_KEYS; i++) {
+            // deletes the msgs never proc()'ed
+            linked_list_destroy(&mKeyQs[i].mMsgs);
+        }
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mMutex);
+    }
+    // returns false if the pool is stopped, in which case the caller
+    // still owns msg
+    bool send(const LocMsg* msg) {
+        bool sent = false;
+        MsgTaskKeyQ& keyQ = mKeyQs[msg->serialKey() % MSG_TASK_POOL_KEYS];
+        pthread_mutex_lock(&mMutex);
+        if (!mStopped &&
+            eLINKED_LIST_SUCCESS == linked_list_add(keyQ.mMsgs, (void*)msg, LocMsgDestroy)) {
+            sent = true;
+            if (!keyQ.mActive && !keyQ.mReady) {
+                makeReady(keyQ);
+            }
+        }
+        pthread_mutex_unlock(&mMutex);
+        return sent;
+    }
+    // blocks until there is a msg to proc(), and returns it, along with
+    // its FIFO to be done() with afterwards. NULL once stopped.
+    LocMsg* take(MsgTaskKeyQ*& keyQ) {
+        LocMsg* msg = NULL;
+        pthread_mutex_lock(&mMutex);
+        while (!mStopped && NULL == mReadyHead) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        if (!mStopped) {
+            keyQ = mReadyHead;
+            mReadyHead = keyQ->mNextReady;
+            if (NULL == mReadyHead) {
+                mReadyTail = NULL;
+            }
+            keyQ->mReady = false;
+            keyQ->mActive = true;
+            linked_list_remove(keyQ->mMsgs, (void**)&msg);
+        }
+        pthread_mutex_unlock(&mMutex);
+        return msg;
+    }
+    void done(MsgTaskKeyQ& keyQ) {
+        pthread_mutex_lock(&mMutex);
+        keyQ.mActive = false;
+        if (!linked_list_empty(keyQ.mMsgs)) {
+            makeReady(keyQ);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    // workers return from take() with NULL; their current msgs still
+    // finish, and msgs sent from then on are refused
+    void stop() {
+        pthread_mutex_lock(&mMutex);
+        mStopped = true;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+// runnable of each of the threads of a pooled MsgTask
+class MsgTaskWorker : public LocRunnable {
+    MsgTask* mTask;
+public:
+    inline MsgTaskWorker(MsgTask* task) : LocRunnable(), mTask(task) {}
+    inline virtual bool run() { return mTask->runPooled(); }
+    inline virtual void prerun() { mTask->prerun(); }
+};
+
+static const void* LocMsgQInit(const MsgTaskConfig& config) {
+    void* q = NULL;
+    if (!LocMsgLockFree(config) && !LocMsgPooled(config)) {
+        if (eMSG_Q_SUCCESS != msg_q_init_bounded(&q, config.mCapacity, config.mFullPolicy)) {
+            q = NULL;
+        } else {
+            msg_q_set_high_burst(q, config.mHighBurst);
+        }
+    }
+    return q;
+}
+
+static void* LocMsgBatchInit(const MsgTaskConfig& config) {
+    void* batch = NULL;
+    if (config.mBatchDrain && !LocMsgLockFree(config) && !LocMsgPooled(config) &&
+        eLINKED_LIST_SUCCESS != linked_list_init(&batch)) {
+        batch = NULL;
+    }
+    return batch;
+}
+
+static int LocMsgEventFdInit(const MsgTaskConfig& config) {
+    int fd = -1;
+    if (config.mPollable) {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (-1 == fd) {
+            LOC_LOGE("%s:%d] eventfd failure - %s\n", __func__, __LINE__, strerror(errno));
+        }
+    }
+    return fd;
+}
+
 MsgTask::MsgTask(LocThread::tCreate tCreator,
-                 const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
-    if (!mThread->start(tCreator, threadName, this, joinable)) {
-        delete mThread;
-        mThread = NULL;
+                 const char* threadName, bool joinable,
+                 const MsgTaskConfig& config) :
+    mQ(LocMsgQInit(config)),
+    mLockFreeQ(LocMsgLockFree(config) ? new LocMpscQueue() : NULL),
+    mBatch(LocMsgBatchInit(config)),
+    mThread(NULL),
+    mSupersede(config.mSupersede && !LocMsgLockFree(config)),
+    mStats(LocMsgStatsInit(this, threadName, config)),
+    mEventFd(LocMsgEventFdInit(config)),
+    mSignalled(false),
+    mPool(NULL) {
+    if (!config.mPollable) {
+        startThreads(tCreator, threadName, joinable, config.mWorkers);
     }
 }
 
-MsgTask::MsgTask(const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
-    if (!mThread->start(threadName, this, joinable)) {
-        delete mThread;
-        mThread = NULL;
+MsgTask::MsgTask(const char* threadName, bool joinable,
+                 const MsgTaskConfig& config) :
+    mQ(LocMsgQInit(config)),
+    mLockFreeQ(LocMsgLockFree(config) ? new LocMpscQueue() : NULL),
+    mBatch(LocMsgBatchInit(config)),
+    mThread(NULL),
+    mSupersede(config.mSupersede && !LocMsgLockFree(config)),
+    mStats(LocMsgStatsInit(this, threadName, config)),
+    mEventFd(LocMsgEventFdInit(config)),
+    mSignalled(false),
+    mPool(NULL) {
+    if (!config.mPollable) {
+        startThreads(NULL, threadName, joinable, config.mWorkers);
+    }
+}
+
+// a single thread running this MsgTask itself; or, for more workers, as
+// many MsgTaskWorkers, named threadName0, threadName1, etc., all with the
+// LocThreadProfile of threadName. Pool threads are always joinable, as
+// destroy() has to wait for them before the pool can go.
+void MsgTask::startThreads(LocThread::tCreate tCreator, const char* threadName,
+                           bool joinable, uint32_t workers) {
+    if (workers <= 1) {
+        mThread = new LocThread();
+        if (!mThread->start(tCreator, threadName, this, joinable)) {
+            delete mThread;
+            mThread = NULL;
+        }
+        return;
+    }
+
+    LocThreadProfile profile;
+    if (threadName) {
+        profile.read(threadName);
+    }
+    mPool = new MsgTaskPool(workers);
+    for (uint32_t i = 0; i < workers; i++) {
+        // thread names are limited to 15 chars, so the base name is cut
+        // short to keep the worker index
+        char name[16];
+        char index[12];
+        const char* base = threadName ? threadName : "MsgTask";
+        size_t indexLen = snprintf(index, sizeof(index), "%u", i);
+        size_t baseLen = strnlen(base, sizeof(name) - 1 - indexLen);
+        memcpy(name, base, baseLen);
+        memcpy(name + baseLen, index, indexLen + 1);
+        MsgTaskWorker* worker = new MsgTaskWorker(this);
+        if (!mPool->mThreads[i].start(tCreator, name, worker, true, profile)) {
+            LOC_LOGE("%s:%d] failed to start worker %s\n", __func__, __LINE__, name);
+            delete worker;
+        }
     }
 }
 
 MsgTask::~MsgTask() {
-    msg_q_flush((void*)mQ);
-    msg_q_destroy((void**)&mQ);
+    flush();
+    if (mBatch) {
+        // deletes the msgs of an interrupted batch, if any
+        linked_list_destroy(&mBatch);
+    }
+    if (mPool) {
+        delete mPool;
+        mPool = NULL;
+    } else if (mLockFreeQ) {
+        delete mLockFreeQ;
+        mLockFreeQ = NULL;
+    } else {
+        msg_q_destroy((void**)&mQ);
+    }
+    if (mStats) {
+        delete mStats;
+        mStats = NULL;
+    }
+    if (-1 != mEventFd) {
+        close(mEventFd);
+    }
+}
+
+// deletes all the msgs still in the queue. MsgTask thread context only,
+// or after the thread is gone.
+void MsgTask::flush() {
+    if (mPool) {
+        // the pool deletes its msgs as it goes
+    } else if (mLockFreeQ) {
+        for (LocMpscLink* link = mLockFreeQ->tryPop();
+             NULL != link;
+             link = mLockFreeQ->tryPop()) {
+            delete static_cast<LocMsg*>(link);
+        }
+    } else {
+        msg_q_flush((void*)mQ);
+    }
 }
 
 void MsgTask::destroy() {
-    msg_q_unblock((void*)mQ);
+    if (mPool) {
+        mPool->stop();
+        // joins each of the workers
+        for (uint32_t i = 0; i < mPool->mNumThreads; i++) {
+            mPool->mThreads[i].stop();
+        }
+        delete this;
+        return;
+    }
+    if (mLockFreeQ) {
+        mLockFreeQ->unblock();
+    } else {
+        msg_q_unblock((void*)mQ);
+    }
     if (mThread) {
         LocThread* thread = mThread;
         mThread = NULL;
@@ -74,29 +535,185 @@ void MsgTask::destroy() {
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
-    msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
+    sendMsg(msg, msg->priority());
+}
+
+void MsgTask::sendMsg(const LocMsg* msg, msg_q_prio_type prio) const {
+    if (mStats) {
+        mStats->onSend(msg);
+    }
+    if (mPool) {
+        if (!mPool->send(msg)) {
+            LOC_LOGE("%s:%d] fail sending msg: pool stopped\n", __func__, __LINE__);
+            if (mStats) {
+                mStats->onDrop();
+            }
+            delete msg;
+        }
+    } else if (mLockFreeQ) {
+        // LocMsg is const to the clients, the link in it is not
+        if (!mLockFreeQ->push(const_cast<LocMsg&>(*msg))) {
+            LOC_LOGE("%s:%d] fail sending msg: queue unblocked\n", __func__, __LINE__);
+            if (mStats) {
+                mStats->onDrop();
+            }
+            delete msg;
+        } else if (-1 != mEventFd && !mSignalled.exchange(true)) {
+            // the msg is linked before mSignalled is looked at, so if it
+            // is already set, drain() is yet to clear it and pop the msg
+            uint64_t one = 1;
+            if (sizeof(one) != write(mEventFd, &one, sizeof(one))) {
+                LOC_LOGE("%s:%d] eventfd write failure - %s\n", __func__, __LINE__,
+                         strerror(errno));
+            }
+        }
+    } else {
+        msq_q_err_type result = msg_q_snd_prio((void*)mQ, (void*)msg, LocMsgDestroy,
+                                               msg->coalesceKey(), prio, mSupersede);
+        if (eMSG_Q_SUCCESS > result) {
+            LOC_LOGE("%s:%d] fail sending msg: %s\n", __func__, __LINE__,
+                     loc_get_msg_q_status(result));
+            if (mStats) {
+                mStats->onDrop();
+            }
+            delete msg;
+        } else if (eMSG_Q_HIGH_WATER_MARK == result) {
+            msg_q_stats_type stats;
+            if (eMSG_Q_SUCCESS == msg_q_get_stats((void*)mQ, &stats)) {
+                LOC_LOGW("%s:%d] %s: high water %u capacity %u\n", __func__, __LINE__,
+                         loc_get_msg_q_status(result), stats.high_water, stats.capacity);
+            }
+        } else if (eMSG_Q_SUCCESS != result) {
+            LOC_LOGV("%s:%d] %s\n", __func__, __LINE__, loc_get_msg_q_status(result));
+        }
+    }
+}
+
+bool MsgTask::getStats(msg_q_stats_type& stats) const {
+    return (NULL != mQ) && (eMSG_Q_SUCCESS == msg_q_get_stats((void*)mQ, &stats));
+}
+
+void MsgTask::dumpStats() const {
+    if (mStats) {
+        mStats->dump();
+    }
+}
+
+void MsgTask::dumpAllStats() {
+    pthread_mutex_lock(&MsgTaskStats::sListMutex);
+    for (MsgTaskStats* stats = MsgTaskStats::sList; stats; stats = stats->mNext) {
+        stats->dump();
+    }
+    pthread_mutex_unlock(&MsgTaskStats::sListMutex);
+}
+
+void MsgTask::drain() {
+    if (-1 == mEventFd) {
+        return;
+    }
+    // resets the eventfd counter. EAGAIN only means that the msgs were
+    // already taken by the previous drain().
+    uint64_t count;
+    if (sizeof(count) != read(mEventFd, &count, sizeof(count)) && EAGAIN != errno) {
+        LOC_LOGE("%s:%d] eventfd read failure - %s\n", __func__, __LINE__, strerror(errno));
+    }
+    // cleared before popping, so a msg sent from here on signals again
+    mSignalled.store(false);
+
+    // a NULL tryPop() with msgs still in the queue means a producer is
+    // half way through sendMsg(); it will signal once it is done.
+    for (LocMpscLink* link = mLockFreeQ->tryPop();
+         NULL != link;
+         link = mLockFreeQ->tryPop()) {
+        procMsg(static_cast<LocMsg*>(link));
+    }
+}
+
+// there is where each individual msg handling is invoked
+void MsgTask::procMsg(LocMsg* msg) {
+    if (mStats) {
+        uint64_t startNs = LocMsgNowNs();
+        msg->log();
+        msg->proc();
+        mStats->onProc(msg, startNs, LocMsgNowNs());
+    } else {
+        msg->log();
+        msg->proc();
+    }
+    delete msg;
+}
+
+// run() of each of the workers of a pooled MsgTask
+bool MsgTask::runPooled() {
+    MsgTaskKeyQ* keyQ = NULL;
+    LocMsg* msg = mPool->take(keyQ);
+    if (NULL == msg) {
+        return false;
+    }
+    procMsg(msg);
+    mPool->done(*keyQ);
+    return true;
 }
 
 void MsgTask::prerun() {
-    // make sure we do not run in background scheduling group
+    // make sure we do not run in background scheduling group. The policy,
+    // priority and cpus of the thread's LocThreadProfile, if any, are
+    // applied after this.
     set_sched_policy(gettid(), SP_FOREGROUND);
 }
 
-bool MsgTask::run() {
-    LOC_LOGV("MsgTask::loop() listening ...\n");
-    LocMsg* msg;
-    msq_q_err_type result = msg_q_rcv((void*)mQ, (void **)&msg);
+// takes all the pending msgs from mQ at once, then proc() them outside
+// of the msg_q lock, in the order they were sent.
+bool MsgTask::runBatch() {
+    LOC_LOGV("MsgTask::loop() listening for batch ...\n");
+    msq_q_err_type result = msg_q_rcv_all((void*)mQ, &mBatch);
     if (eMSG_Q_SUCCESS != result) {
-        LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
+        LOC_LOGE("%s:%d] fail receiving msgs: %s\n", __func__, __LINE__,
                  loc_get_msg_q_status(result));
         return false;
     }
 
-    msg->log();
-    // there is where each individual msg handling is invoked
-    msg->proc();
+    LocMsg* msg;
+    while (eLINKED_LIST_SUCCESS == linked_list_remove(mBatch, (void**)&msg)) {
+        procMsg(msg);
+    }
 
-    delete msg;
+    IF_LOC_LOGV {
+        msg_q_stats_type stats;
+        if (eMSG_Q_SUCCESS == msg_q_get_stats((void*)mQ, &stats) &&
+            0 != stats.rcv_all_calls) {
+            LOC_LOGV("%s:%d] %llu batches, avg batch size %.2f\n", __func__, __LINE__,
+                     (unsigned long long)stats.rcv_all_calls,
+                     (double)stats.rcv_all_msgs / stats.rcv_all_calls);
+        }
+    }
+
+    return true;
+}
+
+bool MsgTask::run() {
+    if (mBatch) {
+        return runBatch();
+    }
+
+    LOC_LOGV("MsgTask::loop() listening ...\n");
+    LocMsg* msg;
+    if (mLockFreeQ) {
+        msg = static_cast<LocMsg*>(mLockFreeQ->pop());
+        if (NULL == msg) {
+            LOC_LOGE("%s:%d] fail receiving msg: queue unblocked\n", __func__, __LINE__);
+            return false;
+        }
+    } else {
+        msq_q_err_type result = msg_q_rcv((void*)mQ, (void **)&msg);
+        if (eMSG_Q_SUCCESS != result) {
+            LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
+                     loc_get_msg_q_status(result));
+            return false;
+        }
+    }
+
+    procMsg(msg);
 
     return true;
 }
@@ -30,26 +30,144 @@
 #define __MSG_TASK__
 
 #include <LocThread.h>
+#include <LocMpscQueue.h>
+#include <msg_q.h>
 
-struct LocMsg {
-    inline LocMsg() {}
+// LocMsg extends LocMpscLink so that it can be queued into a lock free
+// MsgTask without any allocation per sendMsg().
+struct LocMsg : public LocMpscLink {
+    // CLOCK_MONOTONIC time in ns this msg was sent at, only stamped by an
+    // instrumented MsgTask
+    mutable uint64_t mSentNs;
+    inline LocMsg() : LocMpscLink(), mSentNs(0) {}
     inline virtual ~LocMsg() {}
     virtual void proc() const = 0;
     inline virtual void log() const {}
+    // kind of this msg, for a superseding MsgTask, or a bounded one with
+    // eMSG_Q_FULL_COALESCE policy, to tell which queued msg this one
+    // supersedes. 0 if this msg must never be dropped.
+    inline virtual uint32_t coalesceKey() const { return 0; }
+    // lane of the MsgTask this msg goes to, unless sendMsg() is told
+    // otherwise. Msgs of the same lane are received in the order they are
+    // sent. Bulk reports that all other msgs may overtake override this
+    // to eMSG_Q_PRIO_NORMAL.
+    inline virtual msg_q_prio_type priority() const { return eMSG_Q_PRIO_HIGH; }
+    // name of this msg type in the stats of an instrumented MsgTask. Stats
+    // are kept per returned pointer, so it must be a string literal.
+    inline virtual const char* name() const { return "LocMsg"; }
+    // msgs of the same key are proc()'ed one at a time, in the order they
+    // are sent. A pooled MsgTask, see MsgTaskConfig::mWorkers, proc()'es
+    // msgs of different keys in parallel; a single threaded one in order.
+    inline virtual uint32_t serialKey() const { return 0; }
 };
 
+// options a MsgTask is created with. The default ones give a msg_q backed
+// MsgTask.
+struct MsgTaskConfig {
+    // true to queue msgs in a LocMpscQueue instead of msg_q. sendMsg() then
+    //      neither allocates nor locks, unless the MsgTask thread is idle.
+    bool mLockFree;
+    // true to take all the pending msgs out of msg_q per wakeup, with a
+    //      single lock, and then proc() them in order. Lock free queue
+    //      does not lock per msg anyway, so this is for msg_q only.
+    bool mBatchDrain;
+    // max number of msgs pending in msg_q; 0 for unbounded. Lock free
+    // queue is always unbounded.
+    uint32_t mCapacity;
+    // what sendMsg() does when msg_q is at mCapacity
+    msg_q_full_policy_type mFullPolicy;
+    // true to drop a pending msg when a newer msg of the same non-zero
+    //      LocMsg::coalesceKey() is sent, full or not. msg_q only.
+    bool mSupersede;
+    // max number of high priority msgs proc()'ed in a row while normal
+    // priority msgs are waiting; 0 for strict priority. msg_q only, the
+    // lock free queue has a single lane.
+    uint32_t mHighBurst;
+    // true to keep queue depth, and per LocMsg::name() wait and proc()
+    //      time histograms, see MsgTask::dumpStats(). Also turned on for
+    //      all MsgTasks by setting MSG_TASK_INSTRUMENT_PROP to 1.
+    bool mInstrument;
+    // true to create no thread. sendMsg() instead signals an eventfd, see
+    //      MsgTask::getFd(), and whoever polls that fd, along with its own
+    //      fds, calls MsgTask::drain() when it is readable. Always uses
+    //      the lock free queue.
+    bool mPollable;
+    // number of threads. More than 1 for a pool of threads that proc()
+    //      msgs of different LocMsg::serialKey() in parallel. Each key has
+    //      its own FIFO; mLockFree, mBatchDrain, mCapacity, mSupersede and
+    //      mHighBurst do not apply. Not applicable to a pollable MsgTask.
+    uint32_t mWorkers;
+    inline MsgTaskConfig() : mLockFree(false), mBatchDrain(false),
+                             mCapacity(0), mFullPolicy(eMSG_Q_FULL_BLOCK),
+                             mSupersede(false), mHighBurst(8),
+                             mInstrument(false), mPollable(false),
+                             mWorkers(1) {}
+};
+
+// property read at MsgTask creation; "1" instruments every MsgTask
+#define MSG_TASK_INSTRUMENT_PROP "persist.gps.msgtask.instrument"
+// property polled by instrumented MsgTasks, about once a second; every
+// new value set to it, e.g. "setprop debug.gps.msgtask.dump 1", then 2,
+// gets each of them to dump its stats once.
+#define MSG_TASK_DUMP_PROP "debug.gps.msgtask.dump"
+
+class MsgTaskStats;
+class MsgTaskPool;
+
 class MsgTask : public LocRunnable {
     const void* mQ;
+    LocMpscQueue* mLockFreeQ;
+    // list of msgs taken out of mQ in batch drain mode, NULL otherwise
+    void* mBatch;
     LocThread* mThread;
+    const bool mSupersede;
+    // NULL unless instrumented
+    MsgTaskStats* mStats;
+    // eventfd of a pollable MsgTask, -1 otherwise
+    const int mEventFd;
+    // true while mEventFd has been written to and not yet drain()'ed, so
+    // that a burst of sendMsg() costs a single write()
+    mutable std::atomic<bool> mSignalled;
+    // the worker threads and per key FIFOs if pooled, NULL otherwise
+    MsgTaskPool* mPool;
     friend class LocThreadDelegate;
+    friend class MsgTaskWorker;
+    void startThreads(LocThread::tCreate tCreator, const char* threadName,
+                      bool joinable, uint32_t workers);
+    void flush();
+    bool runBatch();
+    bool runPooled();
+    void procMsg(LocMsg* msg);
 protected:
     virtual ~MsgTask();
 public:
-    MsgTask(LocThread::tCreate tCreator, const char* threadName = NULL, bool joinable = true);
-    MsgTask(const char* threadName = NULL, bool joinable = true);
-    // this obj will be deleted once thread is deleted
+    MsgTask(LocThread::tCreate tCreator, const char* threadName = NULL, bool joinable = true,
+            const MsgTaskConfig& config = MsgTaskConfig());
+    MsgTask(const char* threadName = NULL, bool joinable = true,
+            const MsgTaskConfig& config = MsgTaskConfig());
+    // this obj will be deleted once thread is deleted. A pollable MsgTask
+    // is deleted right away, so it must be called from the thread that
+    // drain()'s it, or after that thread is done polling. A pooled one
+    // waits for its workers to finish their current msgs, so it must not
+    // be called from a msg proc().
     void destroy();
+    // fd to poll for EPOLLIN / POLLIN on; -1 unless pollable
+    inline int getFd() const { return mEventFd; }
+    // proc()'es all the msgs pending in a pollable MsgTask, without ever
+    // blocking. To be called by one and the same thread, each time
+    // getFd() is readable.
+    void drain();
+    // sends msg to the lane of msg->priority()
     void sendMsg(const LocMsg* msg) const;
+    void sendMsg(const LocMsg* msg, msg_q_prio_type prio) const;
+    // snapshot of the msg_q counters, e.g. how many msgs were superseded
+    // or coalesced. returns false for a lock free MsgTask.
+    bool getStats(msg_q_stats_type& stats) const;
+    // logs depth / peak depth and, per msg type, the wait and proc() time
+    // histograms of this MsgTask. No-op unless instrumented.
+    void dumpStats() const;
+    // dumpStats() of all the instrumented MsgTasks in the process
+    static void dumpAllStats();
     // Overrides of LocRunnable methods
     // This method will be repeated called until it returns false; or
     // until thread is stopped.
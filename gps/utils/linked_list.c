@@ -35,19 +35,187 @@
 #include "platform_lib_includes.h"
 #include <stdlib.h>
 #include <stdint.h>
+#include <pthread.h>
+#include "mem_pool.h"
+
+/* Number of list elements in the pool shared by all the lists */
+#define LINKED_LIST_POOL_SIZE 128
 
 typedef struct list_element {
    struct list_element* next;
    struct list_element* prev;
    void* data_ptr;
    void (*dealloc_func)(void*);
+   uint32_t key;
+   uint32_t hash;                   /* hash of data_ptr, hashed lists only */
+   struct list_element* hash_next;  /* next element in the same bucket */
 }list_element;
 
 typedef struct list_state {
    list_element* p_head;
    list_element* p_tail;
+   list_element** buckets;          /* hashed index; NULL if not hashed */
+   uint32_t bucket_mask;            /* number of buckets - 1 */
+   uint32_t (*hash_func)(void* data);
 } list_state;
 
+static void* elem_pool = NULL;
+static pthread_once_t elem_pool_once = PTHREAD_ONCE_INIT;
+
+static void linked_list_pool_init(void)
+{
+   if( mem_pool_init(&elem_pool, sizeof(list_element), LINKED_LIST_POOL_SIZE) !=
+       eMEM_POOL_SUCCESS )
+   {
+      elem_pool = NULL;
+   }
+}
+
+/*===========================================================================
+FUNCTION    linked_list_elem_alloc / linked_list_elem_free
+
+DESCRIPTION
+   Allocates / frees a list element from / to the element pool shared by all
+   the lists, so that adding and removing do not churn the heap.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   linked_list_elem_alloc: new element; NULL if fails.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static list_element* linked_list_elem_alloc(void)
+{
+   pthread_once(&elem_pool_once, linked_list_pool_init);
+   if( elem_pool == NULL )
+   {
+      return (list_element*)malloc(sizeof(list_element));
+   }
+   return (list_element*)mem_pool_alloc(elem_pool);
+}
+
+static void linked_list_elem_free(list_element* elem)
+{
+   if( elem_pool == NULL )
+   {
+      free(elem);
+   }
+   else
+   {
+      mem_pool_free(elem_pool, elem);
+   }
+}
+
+/*===========================================================================
+FUNCTION    linked_list_bucket
+
+DESCRIPTION
+   Finds the bucket of the hashed index that elements of a hash go to.
+
+   p_list: Hashed list.
+   hash:   Hash of the data.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Head of the bucket chain.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static list_element** linked_list_bucket(list_state* p_list, uint32_t hash)
+{
+   /* fold the high bits in, hashes such as IDs differ in the low bits only
+      as often as not */
+   return &p_list->buckets[(hash ^ (hash >> 16)) & p_list->bucket_mask];
+}
+
+/*===========================================================================
+FUNCTION    linked_list_unhash
+
+DESCRIPTION
+   Takes an element out of the hashed index of a list.
+
+   p_list: Hashed list the element is in.
+   elem:   Element to take out.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void linked_list_unhash(list_state* p_list, list_element* elem)
+{
+   list_element** pp = linked_list_bucket(p_list, elem->hash);
+   while( *pp != NULL && *pp != elem )
+   {
+      pp = &(*pp)->hash_next;
+   }
+   if( *pp != NULL )
+   {
+      *pp = elem->hash_next;
+   }
+   elem->hash_next = NULL;
+}
+
+/*===========================================================================
+FUNCTION    linked_list_unlink
+
+DESCRIPTION
+   Takes an element out of the list, without freeing it.
+
+   p_list: List the element is in.
+   elem:   Element to unlink.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void linked_list_unlink(list_state* p_list, list_element* elem)
+{
+   if( p_list->buckets != NULL )
+   {
+      linked_list_unhash(p_list, elem);
+   }
+
+   if( elem->prev == NULL )
+   {
+      p_list->p_head = elem->next;
+   }
+   else
+   {
+      elem->prev->next = elem->next;
+   }
+
+   if( elem->next == NULL )
+   {
+      p_list->p_tail = elem->prev;
+   }
+   else
+   {
+      elem->next->prev = elem->prev;
+   }
+
+   elem->prev = elem->next = NULL;
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -79,6 +247,48 @@ linked_list_err_type linked_list_init(void** list_data)
    return eLINKED_LIST_SUCCESS;
 }
 
+/*===========================================================================
+
+  FUNCTION:   linked_list_init_hashed
+
+  ===========================================================================*/
+linked_list_err_type linked_list_init_hashed(void** list_data, uint32_t (*hash)(void* data),
+                                             uint32_t num_buckets)
+{
+   uint32_t n = 1;
+   if( hash == NULL || num_buckets == 0 || num_buckets > (1u << 16) )
+   {
+      LOC_LOGE("%s: Invalid hash parameters! hash %p num_buckets %u\n",
+               __FUNCTION__, hash, num_buckets);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   linked_list_err_type rv = linked_list_init(list_data);
+   if( rv != eLINKED_LIST_SUCCESS )
+   {
+      return rv;
+   }
+
+   /* Round up to a power of 2 */
+   while( n < num_buckets )
+   {
+      n <<= 1;
+   }
+
+   list_state* p_list = (list_state*)*list_data;
+   p_list->buckets = (list_element**)calloc(n, sizeof(list_element*));
+   if( p_list->buckets == NULL )
+   {
+      LOC_LOGE("%s: Unable to allocate space for buckets!\n", __FUNCTION__);
+      linked_list_destroy(list_data);
+      return eLINKED_LIST_FAILURE_GENERAL;
+   }
+   p_list->bucket_mask = n - 1;
+   p_list->hash_func = hash;
+
+   return eLINKED_LIST_SUCCESS;
+}
+
 /*===========================================================================
 
   FUNCTION:   linked_list_destroy
@@ -96,6 +306,7 @@ linked_list_err_type linked_list_destroy(void** list_data)
 
    linked_list_flush(p_list);
 
+   free(p_list->buckets);
    free(*list_data);
    *list_data = NULL;
 
@@ -108,6 +319,17 @@ linked_list_err_type linked_list_destroy(void** list_data)
 
   ===========================================================================*/
 linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dealloc)(void*))
+{
+   return linked_list_add_keyed(list_data, data_obj, dealloc, LINKED_LIST_NO_KEY);
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_add_keyed
+
+  ===========================================================================*/
+linked_list_err_type linked_list_add_keyed(void* list_data, void *data_obj,
+                                           void (*dealloc)(void*), uint32_t key)
 {
    LOC_LOGV("%s: Adding to list data_obj = 0x%08X\n", __FUNCTION__, data_obj);
    if( list_data == NULL )
@@ -123,7 +345,7 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
    }
 
    list_state* p_list = (list_state*)list_data;
-   list_element* elem = (list_element*)malloc(sizeof(list_element));
+   list_element* elem = linked_list_elem_alloc();
    if( elem == NULL )
    {
       LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
@@ -135,6 +357,18 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
    elem->next = NULL;
    elem->prev = NULL;
    elem->dealloc_func = dealloc;
+   elem->key = key;
+   elem->hash_next = NULL;
+
+   if( p_list->buckets != NULL )
+   {
+      /* Newest first in the bucket, as in the list */
+      list_element** bucket;
+      elem->hash = p_list->hash_func(data_obj);
+      bucket = linked_list_bucket(p_list, elem->hash);
+      elem->hash_next = *bucket;
+      *bucket = elem;
+   }
 
    /* Replace head element */
    list_element* tmp = p_list->p_head;
@@ -183,22 +417,58 @@ linked_list_err_type linked_list_remove(void* list_data, void **data_obj)
    list_element* tmp = p_list->p_tail;
 
    /* Replace tail element */
-   p_list->p_tail = tmp->prev;
+   linked_list_unlink(p_list, tmp);
+
+   /* Copy data to output param */
+   *data_obj = tmp->data_ptr;
+
+   /* Free allocated list element */
+   linked_list_elem_free(tmp);
 
-   if( p_list->p_tail != NULL )
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_remove_keyed
+
+  ===========================================================================*/
+linked_list_err_type linked_list_remove_keyed(void* list_data, uint32_t key, void **data_obj)
+{
+   LOC_LOGV("%s: Removing key %u from list\n", __FUNCTION__, key);
+   if( list_data == NULL )
    {
-      p_list->p_tail->next = NULL;
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
    }
-   else
+
+   list_state* p_list = (list_state*)list_data;
+   list_element* tmp = p_list->p_tail;
+
+   /* Oldest elements are at the tail */
+   while( tmp != NULL &&
+          (key == LINKED_LIST_ANY_KEY ? tmp->key == LINKED_LIST_NO_KEY : tmp->key != key) )
    {
-      p_list->p_head = p_list->p_tail;
+      tmp = tmp->prev;
    }
 
-   /* Copy data to output param */
-   *data_obj = tmp->data_ptr;
+   if( tmp == NULL )
+   {
+      return eLINKED_LIST_UNAVAILABLE_RESOURCE;
+   }
 
-   /* Free allocated list element */
-   free(tmp);
+   linked_list_unlink(p_list, tmp);
+
+   if( data_obj != NULL )
+   {
+      *data_obj = tmp->data_ptr;
+   }
+   else if( tmp->dealloc_func != NULL )
+   {
+      tmp->dealloc_func(tmp->data_ptr);
+   }
+
+   linked_list_elem_free(tmp);
 
    return eLINKED_LIST_SUCCESS;
 }
@@ -249,13 +519,63 @@ linked_list_err_type linked_list_flush(void* list_data)
       }
 
       /* Free list element */
-      free(p_list->p_head);
+      linked_list_elem_free(p_list->p_head);
 
       p_list->p_head = tmp;
    }
 
    p_list->p_tail = NULL;
 
+   if( p_list->buckets != NULL )
+   {
+      memset(p_list->buckets, 0, (p_list->bucket_mask + 1) * sizeof(list_element*));
+   }
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_splice
+
+  ===========================================================================*/
+linked_list_err_type linked_list_splice(void* dst_list_data, void* src_list_data)
+{
+   if( dst_list_data == NULL || src_list_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   list_state* p_dst = (list_state*)dst_list_data;
+   list_state* p_src = (list_state*)src_list_data;
+
+   if( p_dst->buckets != NULL || p_src->buckets != NULL )
+   {
+      LOC_LOGE("%s: Hashed lists can not be spliced!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   if( p_src->p_head == NULL || p_src == p_dst )
+   {
+      return eLINKED_LIST_SUCCESS;
+   }
+
+   /* Newest elements are at the head; src ones become newer than dst ones */
+   if( p_dst->p_head == NULL )
+   {
+      p_dst->p_tail = p_src->p_tail;
+   }
+   else
+   {
+      p_src->p_tail->next = p_dst->p_head;
+      p_dst->p_head->prev = p_src->p_tail;
+   }
+   p_dst->p_head = p_src->p_head;
+
+   p_src->p_head = NULL;
+   p_src->p_tail = NULL;
+
    return eLINKED_LIST_SUCCESS;
 }
 
@@ -295,26 +615,14 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
        }
 
        if (rm_if_found) {
-         if (NULL == tmp->prev) {
-           p_list->p_head = tmp->next;
-         } else {
-           tmp->prev->next = tmp->next;
-         }
-
-         if (NULL == tmp->next) {
-           p_list->p_tail = tmp->prev;
-         } else {
-           tmp->next->prev = tmp->prev;
-         }
-
-         tmp->prev = tmp->next = NULL;
+         linked_list_unlink(p_list, tmp);
 
          // dealloc data if it is not copied out && caller
          // has given us a dealloc function pointer.
          if (NULL == data_p && NULL != tmp->dealloc_func) {
              tmp->dealloc_func(tmp->data_ptr);
          }
-         free(tmp);
+         linked_list_elem_free(tmp);
        }
 
        tmp = NULL;
@@ -326,3 +634,87 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
    return eLINKED_LIST_SUCCESS;
 }
 
+/*===========================================================================
+
+  FUNCTION:   linked_list_search_hashed
+
+  ===========================================================================*/
+linked_list_err_type linked_list_search_hashed(void* list_data, void **data_p, uint32_t hash,
+                                               bool (*equal)(void* data_0, void* data),
+                                               void* data_0, bool rm_if_found)
+{
+   LOC_LOGV("%s: Search the list for hash %u\n", __FUNCTION__, hash);
+   if( list_data == NULL || NULL == equal )
+   {
+      LOC_LOGE("%s: Invalid list parameter! list_data %p equal %p\n",
+               __FUNCTION__, list_data, equal);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   list_state* p_list = (list_state*)list_data;
+   if( p_list->buckets == NULL )
+   {
+      return linked_list_search(list_data, data_p, equal, data_0, rm_if_found);
+   }
+
+   if( p_list->p_tail == NULL )
+   {
+      return eLINKED_LIST_UNAVAILABLE_RESOURCE;
+   }
+
+   if( NULL != data_p )
+   {
+      *data_p = NULL;
+   }
+
+   list_element* tmp = *linked_list_bucket(p_list, hash);
+   while( tmp != NULL && (tmp->hash != hash || !(*equal)(data_0, tmp->data_ptr)) )
+   {
+      tmp = tmp->hash_next;
+   }
+
+   if( tmp != NULL )
+   {
+      if( NULL != data_p )
+      {
+         *data_p = tmp->data_ptr;
+      }
+
+      if( rm_if_found )
+      {
+         linked_list_unlink(p_list, tmp);
+
+         /* dealloc data if it is not copied out && caller
+            has given us a dealloc function pointer. */
+         if( NULL == data_p && NULL != tmp->dealloc_func )
+         {
+            tmp->dealloc_func(tmp->data_ptr);
+         }
+         linked_list_elem_free(tmp);
+      }
+   }
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_get_pool_stats
+
+  ===========================================================================*/
+linked_list_err_type linked_list_get_pool_stats(mem_pool_stats_type* stats)
+{
+   if( stats == NULL )
+   {
+      LOC_LOGE("%s: Invalid stats parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   pthread_once(&elem_pool_once, linked_list_pool_init);
+   if( elem_pool == NULL || mem_pool_get_stats(elem_pool, stats) != eMEM_POOL_SUCCESS )
+   {
+      return eLINKED_LIST_UNAVAILABLE_RESOURCE;
+   }
+
+   return eLINKED_LIST_SUCCESS;
+}
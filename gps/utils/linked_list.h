@@ -34,6 +34,8 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include "mem_pool.h"
 
 /** Linked List Return Codes */
 typedef enum
@@ -52,6 +54,11 @@ typedef enum
      /**< Failed because an the supplied buffer was too small. */
 }linked_list_err_type;
 
+/** Key of elements added without a key */
+#define LINKED_LIST_NO_KEY  ((uint32_t)0)
+/** Key to match any element added with a key, for linked_list_remove_keyed */
+#define LINKED_LIST_ANY_KEY ((uint32_t)-1)
+
 /*===========================================================================
 FUNCTION    linked_list_init
 
@@ -72,6 +79,35 @@ SIDE EFFECTS
 ===========================================================================*/
 linked_list_err_type linked_list_init(void** list_data);
 
+/*===========================================================================
+FUNCTION    linked_list_init_hashed
+
+DESCRIPTION
+   Initializes a list that also keeps a hashed index of its elements, so
+   that linked_list_search_hashed finds and removes an element in constant
+   time. Everything else works as with a list from linked_list_init, but
+   hashed lists can not be spliced.
+
+   list_data:    State of list to be initialized.
+   hash:         Function that hashes the data of an element. Data that
+                 are equal per the equal function given to
+                 linked_list_search_hashed must hash the same.
+   num_buckets:  Size of the index, rounded up to a power of 2; about the
+                 number of elements expected in the list.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_init_hashed(void** list_data, uint32_t (*hash)(void* data),
+                                             uint32_t num_buckets);
+
 /*===========================================================================
 FUNCTION    linked_list_destroy
 
@@ -117,6 +153,32 @@ SIDE EFFECTS
 ===========================================================================*/
 linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dealloc)(void*));
 
+/*===========================================================================
+FUNCTION    linked_list_add_keyed
+
+DESCRIPTION
+   Same as linked_list_add, except that the element is tagged with a key,
+   such that it can later be found by linked_list_remove_keyed.
+
+   p_list_data:  List to add data to the head of.
+   data_obj:     Pointer to data to add into list
+   dealloc:      Function used to deallocate memory for this element. Pass NULL
+                 if you do not want data deallocated during a flush operation
+   key:          Key of the element. LINKED_LIST_NO_KEY if none.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_add_keyed(void* list_data, void *data_obj,
+                                           void (*dealloc)(void*), uint32_t key);
+
 /*===========================================================================
 FUNCTION    linked_list_remove
 
@@ -139,6 +201,33 @@ SIDE EFFECTS
 ===========================================================================*/
 linked_list_err_type linked_list_remove(void* list_data, void **data_obj);
 
+/*===========================================================================
+FUNCTION    linked_list_remove_keyed
+
+DESCRIPTION
+   Removes the element nearest the list tail, i.e. the oldest one, that was
+   added with the given key.
+
+   p_list_data:  List to remove the element from.
+   key:          Key to look for. LINKED_LIST_ANY_KEY matches any element
+                 that was added with a key other than LINKED_LIST_NO_KEY.
+   data_obj:     Pointer to data removed from list. If passed in as NULL,
+                 the data is deallocated with the dealloc function given
+                 when it was added.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   eLINKED_LIST_UNAVAILABLE_RESOURCE if no element has the key.
+   Otherwise look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_remove_keyed(void* list_data, uint32_t key, void **data_obj);
+
 /*===========================================================================
 FUNCTION    linked_list_empty
 
@@ -182,6 +271,29 @@ SIDE EFFECTS
 ===========================================================================*/
 linked_list_err_type linked_list_flush(void* list_data);
 
+/*===========================================================================
+FUNCTION    linked_list_splice
+
+DESCRIPTION
+   Moves all elements of one list to another, as if each was removed from
+   src_list and added to dst_list in order, without any allocation. The
+   moved elements come out of dst_list after the ones already in it.
+
+   dst_list_data:  List to move the elements to.
+   src_list_data:  List to move the elements from; empty upon return.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_splice(void* dst_list_data, void* src_list_data);
+
 /*===========================================================================
 FUNCTION    linked_list_search
 
@@ -210,6 +322,59 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
                                         bool (*equal)(void* data_0, void* data),
                                         void* data_0, bool rm_if_found);
 
+/*===========================================================================
+FUNCTION    linked_list_get_pool_stats
+
+DESCRIPTION
+   Takes a snapshot of the statistics of the pool that the elements of all
+   the lists are allocated from. Misses are elements that had to be
+   allocated from the heap, the pool being used up.
+
+   stats:  Pointer to space to copy statistics to.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_get_pool_stats(mem_pool_stats_type* stats);
+
+/*===========================================================================
+FUNCTION    linked_list_search_hashed
+
+DESCRIPTION
+   Same as linked_list_search, except that on a hashed list only elements
+   whose data hash to the given hash are compared against, which takes
+   constant time. On a list that is not hashed, it is linked_list_search.
+
+   p_list_data:  List handle.
+   data_p:       to be stored with the data found; NUll if no match.
+                 if data_p passed in as NULL, then no write to it.
+   hash:         Hash of the data being looked for.
+   equal:        Function ptr takes in a list element, and returns
+                 indication if this the one looking for.
+   data_0:       The data being compared against.
+   rm_if_found:  Should data be removed if found?
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_search_hashed(void* list_data, void **data_p, uint32_t hash,
+                                               bool (*equal)(void* data_0, void* data),
+                                               void* data_0, bool rm_if_found);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -37,9 +37,17 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
 #include <loc_cfg.h>
+#include <loc_cfg_blob.h>
 #include <log_util.h>
 #include <loc_misc_utils.h>
+#include <LocThread.h>
 #ifdef USE_GLIB
 #include <glib.h>
 #endif
@@ -54,23 +62,19 @@
 /* Parameter data */
 static uint32_t DEBUG_LEVEL = 0xff;
 static uint32_t TIMESTAMP = 0;
+static uint32_t LOG_RING_KB = 0;
+static char LOG_TAG_LEVELS[LOC_MAX_PARAM_STRING + 1] = "";
 
 /* Parameter spec table */
 static const loc_param_s_type loc_param_table[] =
 {
     {"DEBUG_LEVEL",    &DEBUG_LEVEL, NULL,    'n'},
     {"TIMESTAMP",      &TIMESTAMP,   NULL,    'n'},
+    {"LOG_RING_KB",    &LOG_RING_KB, NULL,    'n'},
+    {"LOG_TAG_LEVELS", &LOG_TAG_LEVELS, NULL, 's'},
 };
 static const int loc_param_num = sizeof(loc_param_table) / sizeof(loc_param_s_type);
 
-typedef struct loc_param_v_type
-{
-    char* param_name;
-    char* param_str_value;
-    int param_int_value;
-    double param_double_value;
-}loc_param_v_type;
-
 /*===========================================================================
 FUNCTION loc_set_config_entry
 
@@ -180,49 +184,30 @@ RETURN VALUE
 SIDE EFFECTS
    N/A
 ===========================================================================*/
+// sets the entries of config_table named by a parsed item, returns how many
+static int loc_set_config_entries(loc_param_v_type* config_value,
+                                  const loc_param_s_type* config_table, uint32_t table_length)
+{
+    int ret = 0;
+    for(uint32_t i = 0; NULL != config_table && i < table_length; i++)
+    {
+        if(!loc_set_config_entry(&config_table[i], config_value)) {
+            ret += 1;
+        }
+    }
+    return ret;
+}
+
 int loc_fill_conf_item(char* input_buf,
                        const loc_param_s_type* config_table, uint32_t table_length)
 {
     int ret = 0;
 
     if (input_buf && config_table) {
-        char *lasts;
         loc_param_v_type config_value;
-        memset(&config_value, 0, sizeof(config_value));
-
-        /* Separate variable and value */
-        config_value.param_name = strtok_r(input_buf, "=", &lasts);
-        /* skip lines that do not contain "=" */
-        if (config_value.param_name) {
-            config_value.param_str_value = strtok_r(NULL, "=", &lasts);
-
-            /* skip lines that do not contain two operands */
-            if (config_value.param_str_value) {
-                /* Trim leading and trailing spaces */
-                loc_util_trim_space(config_value.param_name);
-                loc_util_trim_space(config_value.param_str_value);
-
-                /* Parse numerical value */
-                if ((strlen(config_value.param_str_value) >=3) &&
-                    (config_value.param_str_value[0] == '0') &&
-                    (tolower(config_value.param_str_value[1]) == 'x'))
-                {
-                    /* hex */
-                    config_value.param_int_value = (int) strtol(&config_value.param_str_value[2],
-                                                                (char**) NULL, 16);
-                }
-                else {
-                    config_value.param_double_value = (double) atof(config_value.param_str_value); /* float */
-                    config_value.param_int_value = atoi(config_value.param_str_value); /* dec */
-                }
 
-                for(uint32_t i = 0; NULL != config_table && i < table_length; i++)
-                {
-                    if(!loc_set_config_entry(&config_table[i], &config_value)) {
-                        ret += 1;
-                    }
-                }
-            }
+        if (0 == loc_parse_conf_item(input_buf, &config_value)) {
+            ret = loc_set_config_entries(&config_value, config_table, table_length);
         }
     }
 
@@ -342,26 +327,473 @@ int loc_update_conf(const char* conf_data, int32_t length,
             char* input_buf = strtok_r(conf_copy, "\n", &saveptr);
             ret = 0;
 
+            bool log_updated = false;
+
             LOC_LOGD("%s:%d]: num_params: %d\n", __func__, __LINE__, num_params);
-            while(num_params && input_buf) {
-                ret++;
-                num_params -= loc_fill_conf_item(input_buf, config_table, table_length);
+            while(input_buf) {
+                // parsed once, as parsing tokenizes input_buf in place
+                loc_param_v_type config_value;
+                bool parsed = (0 == loc_parse_conf_item(input_buf, &config_value));
+                if (num_params) {
+                    ret++;
+                    if (parsed) {
+                        num_params -= loc_set_config_entries(&config_value, config_table,
+                                                             table_length);
+                    }
+                }
+                // logging parameters, e.g. LOG_TAG_LEVELS, may be updated too
+                if (parsed &&
+                    loc_set_config_entries(&config_value, loc_param_table, loc_param_num)) {
+                    log_updated = true;
+                }
                 input_buf = strtok_r(NULL, "\n", &saveptr);
             }
             free(conf_copy);
+
+            if (log_updated) {
+                loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
+                loc_log_set_tag_levels(LOG_TAG_LEVELS);
+                loc_log_ring_init(LOG_RING_KB);
+            }
         }
     }
 
     return ret;
 }
 
+/*=============================================================================
+ *
+ *                          CONFIG STORE
+ *
+ * Each config file is mmap'ed and parsed once into a hash map of
+ * name -> typed value. Later loc_read_conf() calls on the same file look
+ * every table entry up by hash instead of re-reading the file and string
+ * comparing each line against each table entry. A file is parsed again
+ * only when its inode, size or modification time changes. A binary image
+ * of the file, when present and current, is loaded instead of parsing.
+ *
+ * Tables registered with loc_watch_conf() are kept in sync with their
+ * file: an inotify watch on the file's directory re-parses the file when
+ * it is written or replaced, and only the entries whose value differs are
+ * set again, each followed by the table's change callback.
+ *
+ *============================================================================*/
+
+#define LOC_CFG_MAX_WATCH_DIRS 8
+
+typedef struct loc_cfg_watch
+{
+    struct loc_cfg_watch* next;
+    const loc_param_s_type* config_table;
+    uint32_t table_length;
+    loc_conf_change_cb change_cb;
+    void* user_data;
+} loc_cfg_watch;
+
+typedef struct loc_cfg_file
+{
+    struct loc_cfg_file* next;
+    char* path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    loc_cfg_map map;
+    loc_cfg_watch* watches;
+} loc_cfg_file;
+
+typedef struct loc_cfg_change
+{
+    const loc_param_s_type* config_entry;
+    loc_conf_change_cb change_cb;
+    void* user_data;
+} loc_cfg_change;
+
+/* entries set again by a reload, whose callbacks are yet to be called */
+typedef struct loc_cfg_changes
+{
+    loc_cfg_change* changes;
+    uint32_t num_changes;
+    uint32_t max_changes;
+    bool log_changed;
+} loc_cfg_changes;
+
+typedef struct loc_cfg_watch_dir
+{
+    int wd;
+    char path[PATH_MAX];
+} loc_cfg_watch_dir;
+
+static pthread_mutex_t loc_cfg_store_mutex = PTHREAD_MUTEX_INITIALIZER;
+static loc_cfg_file* loc_cfg_store = NULL;
+static int loc_cfg_inotify_fd = -1;
+static loc_cfg_watch_dir loc_cfg_watch_dirs[LOC_CFG_MAX_WATCH_DIRS];
+static uint32_t loc_cfg_num_watch_dirs = 0;
+static LocThread* loc_cfg_watch_thread = NULL;
+
+/*===========================================================================
+FUNCTION loc_cfg_load_blob
+
+DESCRIPTION
+   Fills the file's hash map from the binary image of the file, if there
+   is one and it was compiled from the current text.
+
+PARAMETERS:
+   file: store entry to fill
+   data: text content of the config file
+   size: size of the text content
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: loaded from the binary image
+  -1: no usable image, the text is to be parsed
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_cfg_load_blob(loc_cfg_file* file, const char* data, size_t size)
+{
+    char blob_path[PATH_MAX];
+    struct stat st;
+
+    snprintf(blob_path, sizeof(blob_path), "%s%s", file->path, LOC_CFG_BLOB_SUFFIX);
+    int fd = open(blob_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || 0 == st.st_size) {
+        close(fd);
+        return -1;
+    }
+    void* blob = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == blob) {
+        return -1;
+    }
+
+    int ret = loc_cfg_blob_read(&file->map, blob, st.st_size, data, size);
+    munmap(blob, st.st_size);
+
+    switch (ret) {
+    case LOC_CFG_BLOB_OK:
+        return 0;
+    case LOC_CFG_BLOB_STALE:
+        LOC_LOGI("%s: %s is stale, parsing %s", __FUNCTION__, blob_path, file->path);
+        break;
+    case LOC_CFG_BLOB_NO_MEM:
+        LOC_LOGE("%s: out of memory for %s", __FUNCTION__, file->path);
+        break;
+    default:
+        LOC_LOGE("%s: %s is not a valid config image", __FUNCTION__, blob_path);
+        break;
+    }
+    return -1;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_set_entry
+
+DESCRIPTION
+   Sets a configuration table entry from a parsed item, or clears its
+   validity bit if the file has no such item.
+
+PARAMETERS:
+   config_entry: configuration entry in the table to set
+   item: parsed item of the same name, or NULL
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_set_entry(const loc_param_s_type* config_entry,
+                              loc_cfg_item* item)
+{
+    loc_param_v_type config_value;
+
+    if (NULL == item) {
+        if(NULL != config_entry->param_set)
+        {
+            *(config_entry->param_set) = 0;
+        }
+    } else {
+        config_value.param_name = item->name;
+        config_value.param_str_value = item->str_value;
+        config_value.param_int_value = item->int_value;
+        config_value.param_double_value = item->double_value;
+        loc_set_config_entry(config_entry, &config_value);
+    }
+}
+
+static void loc_cfg_add_change(loc_cfg_changes* changes,
+                               const loc_param_s_type* config_entry,
+                               const loc_cfg_watch* watch)
+{
+    if (NULL == watch->change_cb) {
+        return;
+    }
+    if (changes->num_changes == changes->max_changes) {
+        uint32_t max_changes = changes->max_changes ? changes->max_changes * 2 : 16;
+        loc_cfg_change* grown = (loc_cfg_change*)realloc(changes->changes,
+                                                         max_changes * sizeof(loc_cfg_change));
+        if (NULL == grown) {
+            LOC_LOGE("%s: out of memory, dropping change of %s",
+                     __FUNCTION__, config_entry->param_name);
+            return;
+        }
+        changes->changes = grown;
+        changes->max_changes = max_changes;
+    }
+    changes->changes[changes->num_changes].config_entry = config_entry;
+    changes->changes[changes->num_changes].change_cb = watch->change_cb;
+    changes->changes[changes->num_changes].user_data = watch->user_data;
+    changes->num_changes++;
+}
+
+static bool loc_cfg_item_differs(const loc_cfg_item* old_item, const loc_cfg_item* new_item)
+{
+    if (NULL == old_item || NULL == new_item) {
+        return old_item != new_item;
+    }
+    return strcmp(old_item->str_value, new_item->str_value) != 0;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_diff
+
+DESCRIPTION
+   After a file was parsed again, sets the entries of the file's watched
+   tables whose value differs between the old and the new parse, and
+   records them for their change callbacks. The logging parameters are
+   checked the same way.
+
+PARAMETERS:
+   file: store entry holding the new parse
+   old_buckets: hash map of the old parse
+   changes: collects the entries set
+
+DEPENDENCIES
+   Called with loc_cfg_store_mutex held
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_diff(loc_cfg_file* file, loc_cfg_item* const* old_buckets,
+                         loc_cfg_changes* changes)
+{
+    for (loc_cfg_watch* watch = file->watches; NULL != watch; watch = watch->next) {
+        for (uint32_t i = 0; i < watch->table_length; i++) {
+            const loc_param_s_type* config_entry = &watch->config_table[i];
+            loc_cfg_item* old_item = loc_cfg_find(old_buckets, config_entry->param_name);
+            loc_cfg_item* new_item = loc_cfg_find(file->map.buckets, config_entry->param_name);
+
+            if (loc_cfg_item_differs(old_item, new_item)) {
+                LOC_LOGI("%s: %s changed in %s", __FUNCTION__,
+                         config_entry->param_name, file->path);
+                loc_cfg_set_entry(config_entry, new_item);
+                loc_cfg_add_change(changes, config_entry, watch);
+            }
+        }
+    }
+
+    for (int i = 0; i < loc_param_num; i++) {
+        loc_cfg_item* new_item = loc_cfg_find(file->map.buckets, loc_param_table[i].param_name);
+        if (NULL != new_item &&
+            loc_cfg_item_differs(loc_cfg_find(old_buckets, loc_param_table[i].param_name),
+                                 new_item)) {
+            loc_cfg_set_entry(&loc_param_table[i], new_item);
+            changes->log_changed = true;
+        }
+    }
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_get_file
+
+DESCRIPTION
+   Finds the store entry of a config file, parsing the file if it has not
+   been parsed yet or has changed since. When a file that was parsed
+   before is parsed again, its watched tables are updated.
+
+PARAMETERS:
+   conf_file_name: configuration file to read
+   reparse: parse the file even if it looks unchanged, as on an inotify
+            event, for an edit that kept its size and modification time
+   changes: collects the watched entries set by a reload
+
+DEPENDENCIES
+   Called with loc_cfg_store_mutex held
+
+RETURN VALUE
+   store entry, or NULL if the file can not be read
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static loc_cfg_file* loc_cfg_get_file(const char* conf_file_name, bool reparse,
+                                       loc_cfg_changes* changes)
+{
+    struct stat st;
+    loc_cfg_file* file = loc_cfg_store;
+
+    while (NULL != file && strcmp(file->path, conf_file_name) != 0) {
+        file = file->next;
+    }
+
+    if (stat(conf_file_name, &st) != 0) {
+        return NULL;
+    }
+
+    if (NULL != file && file->dev == st.st_dev && file->ino == st.st_ino &&
+        file->size == st.st_size && file->mtime.tv_sec == st.st_mtim.tv_sec &&
+        file->mtime.tv_nsec == st.st_mtim.tv_nsec && !reparse) {
+        return file;
+    }
+
+    int fd = open(conf_file_name, O_RDONLY | O_CLOEXEC);
+    /* take the identity of what is actually opened */
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    void* data = NULL;
+    if (st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (MAP_FAILED == data) {
+        LOC_LOGE("%s: mmap of %s failed, errno %d", __FUNCTION__, conf_file_name, errno);
+        return NULL;
+    }
+
+    if (NULL == file) {
+        file = (loc_cfg_file*)calloc(1, sizeof(loc_cfg_file));
+        if (NULL != file) {
+            file->path = strdup(conf_file_name);
+        }
+        if (NULL == file || NULL == file->path) {
+            LOC_LOGE("%s: out of memory for %s", __FUNCTION__, conf_file_name);
+            free(file);
+            if (NULL != data) {
+                munmap(data, st.st_size);
+            }
+            return NULL;
+        }
+        file->next = loc_cfg_store;
+        loc_cfg_store = file;
+    }
+
+    loc_cfg_item* old_buckets[LOC_CFG_HASH_BUCKETS];
+    memcpy(old_buckets, file->map.buckets, sizeof(old_buckets));
+    memset(file->map.buckets, 0, sizeof(file->map.buckets));
+    file->map.num_items = 0;
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->size = st.st_size;
+    file->mtime = st.st_mtim;
+
+    if (NULL != data) {
+        if (0 != loc_cfg_load_blob(file, (const char*)data, st.st_size)) {
+            loc_cfg_clear(file->map.buckets);
+            file->map.num_items = 0;
+            if (0 != loc_cfg_parse(&file->map, (const char*)data, st.st_size)) {
+                LOC_LOGE("%s: out of memory for %s", __FUNCTION__, conf_file_name);
+            }
+        }
+        munmap(data, st.st_size);
+    }
+    LOC_LOGD("%s: loaded %s, %u items", __FUNCTION__, conf_file_name, file->map.num_items);
+
+    loc_cfg_diff(file, old_buckets, changes);
+    loc_cfg_clear(old_buckets);
+    return file;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_notify
+
+DESCRIPTION
+   Calls the change callbacks collected by loc_cfg_get_file(), and
+   re-initializes logging if its parameters changed.
+
+PARAMETERS:
+   changes: entries set by a reload
+
+DEPENDENCIES
+   Called without loc_cfg_store_mutex held, so callbacks may read config
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_notify(loc_cfg_changes* changes)
+{
+    if (changes->log_changed) {
+        loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
+        loc_log_set_tag_levels(LOG_TAG_LEVELS);
+        loc_log_ring_init(LOG_RING_KB);
+    }
+    for (uint32_t i = 0; i < changes->num_changes; i++) {
+        changes->changes[i].change_cb(changes->changes[i].config_entry,
+                                      changes->changes[i].user_data);
+    }
+    free(changes->changes);
+    memset(changes, 0, sizeof(*changes));
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_apply
+
+DESCRIPTION
+   Sets the entries of a configuration table from a parsed config file,
+   with one hashed lookup per table entry.
+
+PARAMETERS:
+   file: store entry of the config file
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_apply(const loc_cfg_file* file,
+                          const loc_param_s_type* config_table, uint32_t table_length)
+{
+    for(uint32_t i = 0; i < table_length; i++)
+    {
+        loc_cfg_set_entry(&config_table[i],
+                          loc_cfg_find(file->map.buckets, config_table[i].param_name));
+    }
+}
+
 /*===========================================================================
 FUNCTION loc_read_conf
 
 DESCRIPTION
    Reads the specified configuration file and sets defined values based on
    the passed in configuration table. This table maps strings to values to
-   set along with the type of each of these values.
+   set along with the type of each of these values. The file is parsed
+   only once and kept in the config store for later calls.
 
 PARAMETERS:
    conf_file_name: configuration file to read
@@ -379,15 +811,402 @@ SIDE EFFECTS
 ===========================================================================*/
 void loc_read_conf(const char* conf_file_name, const loc_param_s_type* config_table,
                    uint32_t table_length)
+{
+    loc_cfg_changes changes;
+    memset(&changes, 0, sizeof(changes));
+
+    pthread_mutex_lock(&loc_cfg_store_mutex);
+    loc_cfg_file* file = loc_cfg_get_file(conf_file_name, false, &changes);
+    if (NULL != file)
+    {
+        LOC_LOGD("%s: using %s", __FUNCTION__, conf_file_name);
+        if(table_length && config_table) {
+            loc_cfg_apply(file, config_table, table_length);
+        }
+        loc_cfg_apply(file, loc_param_table, loc_param_num);
+    }
+    pthread_mutex_unlock(&loc_cfg_store_mutex);
+
+    loc_cfg_notify(&changes);
+    /* Initialize logging mechanism with parsed data */
+    loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
+    loc_log_set_tag_levels(LOG_TAG_LEVELS);
+    loc_log_ring_init(LOG_RING_KB);
+}
+
+/*===========================================================================
+FUNCTION loc_lookup_conf
+
+DESCRIPTION
+   Sets the entries of a configuration table from the config store. The
+   file is parsed on the first lookup only; later lookups take the values
+   as last parsed, or reloaded by a watch, without checking the file.
+   Unlike loc_read_conf(), the logging parameters are left alone, so this
+   does not undo changes made through loc_update_conf().
+
+PARAMETERS:
+   conf_file_name: configuration file to look up
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: table set
+  -1: the file can not be read
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_lookup_conf(const char* conf_file_name, const loc_param_s_type* config_table,
+                    uint32_t table_length)
+{
+    loc_cfg_changes changes;
+    memset(&changes, 0, sizeof(changes));
+
+    pthread_mutex_lock(&loc_cfg_store_mutex);
+    loc_cfg_file* file = loc_cfg_store;
+    while (NULL != file && strcmp(file->path, conf_file_name) != 0) {
+        file = file->next;
+    }
+    if (NULL == file) {
+        file = loc_cfg_get_file(conf_file_name, false, &changes);
+    }
+    if (NULL != file) {
+        loc_cfg_apply(file, config_table, table_length);
+    }
+    pthread_mutex_unlock(&loc_cfg_store_mutex);
+
+    loc_cfg_notify(&changes);
+    return (NULL != file) ? 0 : -1;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_dir_name / loc_cfg_base_name
+
+DESCRIPTION
+   Split a config file path into the directory to watch, "." for a bare
+   file name and "/" for a file in the root, and the name in it
+
+RETURN VALUE
+   dir, or the name part of path
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static const char* loc_cfg_dir_name(const char* path, char* dir, size_t dir_size)
+{
+    strlcpy(dir, path, dir_size);
+    char* slash = strrchr(dir, '/');
+    if (NULL == slash) {
+        strlcpy(dir, ".", dir_size);
+    } else if (slash == dir) {
+        dir[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+    return dir;
+}
+
+static const char* loc_cfg_base_name(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    return (NULL == slash) ? path : slash + 1;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_on_dir_event
+
+DESCRIPTION
+   Handles an inotify event on the directory of a watched file: reloads
+   every watched file of that name, which updates the watched tables.
+
+PARAMETERS:
+   wd: inotify watch descriptor of the directory
+   name: name of the file written or moved into the directory
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_on_dir_event(int wd, const char* name)
+{
+    char dir[PATH_MAX];
+    loc_cfg_changes changes;
+    memset(&changes, 0, sizeof(changes));
+
+    pthread_mutex_lock(&loc_cfg_store_mutex);
+    for (uint32_t i = 0; i < loc_cfg_num_watch_dirs; i++) {
+        if (loc_cfg_watch_dirs[i].wd != wd) {
+            continue;
+        }
+        // matched by directory and name, as the file was named when read,
+        // e.g. "/gps.conf" or "gps.conf", rather than by a joined path
+        for (loc_cfg_file* file = loc_cfg_store; NULL != file; file = file->next) {
+            if (NULL != file->watches &&
+                strcmp(loc_cfg_base_name(file->path), name) == 0 &&
+                strcmp(loc_cfg_dir_name(file->path, dir, sizeof(dir)),
+                       loc_cfg_watch_dirs[i].path) == 0) {
+                LOC_LOGD("%s: %s written", __FUNCTION__, file->path);
+                loc_cfg_get_file(file->path, true, &changes);
+            }
+        }
+    }
+    pthread_mutex_unlock(&loc_cfg_store_mutex);
+
+    loc_cfg_notify(&changes);
+}
+
+// Reads the inotify events of the directories holding watched files.
+class LocCfgWatcher : public LocRunnable {
+public:
+    virtual bool run() {
+        char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t len = read(loc_cfg_inotify_fd, buf, sizeof(buf));
+
+        if (len < 0 && EINTR == errno) {
+            return true;
+        }
+        if (len <= 0) {
+            LOC_LOGE("%s: inotify read failed, errno %d", __FUNCTION__, errno);
+            return false;
+        }
+        for (char* ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            if (event->len > 0) {
+                loc_cfg_on_dir_event(event->wd, event->name);
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+        return true;
+    }
+};
+
+/*===========================================================================
+FUNCTION loc_cfg_watch_dir_of
+
+DESCRIPTION
+   Adds an inotify watch on the directory of a config file, unless there
+   is one already. Writes in place and files replaced by rename are both
+   seen.
+
+PARAMETERS:
+   conf_file_name: configuration file to watch
+
+DEPENDENCIES
+   Called with loc_cfg_store_mutex held
+
+RETURN VALUE
+   0: directory watched
+  -1: error
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_cfg_watch_dir_of(const char* conf_file_name)
+{
+    char dir[PATH_MAX];
+    loc_cfg_dir_name(conf_file_name, dir, sizeof(dir));
+
+    for (uint32_t i = 0; i < loc_cfg_num_watch_dirs; i++) {
+        if (strcmp(loc_cfg_watch_dirs[i].path, dir) == 0) {
+            return 0;
+        }
+    }
+    if (loc_cfg_num_watch_dirs == LOC_CFG_MAX_WATCH_DIRS) {
+        LOC_LOGE("%s: too many config directories, %s not watched", __FUNCTION__, dir);
+        return -1;
+    }
+
+    if (loc_cfg_inotify_fd < 0) {
+        loc_cfg_inotify_fd = inotify_init1(IN_CLOEXEC);
+        if (loc_cfg_inotify_fd < 0) {
+            LOC_LOGE("%s: inotify_init1 failed, errno %d", __FUNCTION__, errno);
+            return -1;
+        }
+    }
+
+    int wd = inotify_add_watch(loc_cfg_inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        LOC_LOGE("%s: inotify_add_watch %s failed, errno %d", __FUNCTION__, dir, errno);
+        return -1;
+    }
+    loc_cfg_watch_dirs[loc_cfg_num_watch_dirs].wd = wd;
+    strlcpy(loc_cfg_watch_dirs[loc_cfg_num_watch_dirs].path, dir,
+            sizeof(loc_cfg_watch_dirs[loc_cfg_num_watch_dirs].path));
+    loc_cfg_num_watch_dirs++;
+    return 0;
+}
+
+/*===========================================================================
+FUNCTION loc_watch_conf
+
+DESCRIPTION
+   Keeps a configuration table in sync with its configuration file. When
+   the file changes, the entries whose value differs are set again and
+   change_cb is called for each of them, from the config watcher thread
+   or from the loc_read_conf() caller that noticed the change first.
+   The table is expected to be read with loc_read_conf() beforehand;
+   watching a table again replaces its callback.
+
+PARAMETERS:
+   conf_file_name: configuration file to watch
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+   change_cb: called after each changed entry is set, may be NULL
+   user_data: passed to change_cb
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: table watched
+  -1: error
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_watch_conf(const char* conf_file_name, const loc_param_s_type* config_table,
+                   uint32_t table_length, loc_conf_change_cb change_cb, void* user_data)
+{
+    int ret = -1;
+    bool start_thread = false;
+    loc_cfg_changes changes;
+    memset(&changes, 0, sizeof(changes));
+
+    if (NULL == conf_file_name || NULL == config_table || 0 == table_length) {
+        LOC_LOGE("%s: invalid parameters", __FUNCTION__);
+        return ret;
+    }
+
+    pthread_mutex_lock(&loc_cfg_store_mutex);
+    loc_cfg_file* file = loc_cfg_get_file(conf_file_name, false, &changes);
+    if (NULL != file && 0 == loc_cfg_watch_dir_of(conf_file_name)) {
+        loc_cfg_watch* watch = file->watches;
+        while (NULL != watch && watch->config_table != config_table) {
+            watch = watch->next;
+        }
+        if (NULL == watch) {
+            watch = (loc_cfg_watch*)calloc(1, sizeof(loc_cfg_watch));
+            if (NULL != watch) {
+                watch->next = file->watches;
+                file->watches = watch;
+            }
+        }
+        if (NULL != watch) {
+            watch->config_table = config_table;
+            watch->table_length = table_length;
+            watch->change_cb = change_cb;
+            watch->user_data = user_data;
+            ret = 0;
+        }
+    }
+    if (0 == ret && NULL == loc_cfg_watch_thread) {
+        loc_cfg_watch_thread = new LocThread();
+        start_thread = true;
+    }
+    pthread_mutex_unlock(&loc_cfg_store_mutex);
+
+    loc_cfg_notify(&changes);
+    // started outside of the store lock, as the thread reads its profile
+    if (start_thread &&
+        !loc_cfg_watch_thread->start("LocCfgWatch", new LocCfgWatcher(), false)) {
+        LOC_LOGE("%s: failed to start the config watcher", __FUNCTION__);
+    }
+    return ret;
+}
+
+/*===========================================================================
+FUNCTION loc_unwatch_conf
+
+DESCRIPTION
+   Stops keeping a configuration table in sync with its configuration file.
+
+PARAMETERS:
+   config_table: table passed to loc_watch_conf()
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_unwatch_conf(const loc_param_s_type* config_table)
+{
+    pthread_mutex_lock(&loc_cfg_store_mutex);
+    for (loc_cfg_file* file = loc_cfg_store; NULL != file; file = file->next) {
+        for (loc_cfg_watch** watch = &file->watches; NULL != *watch; ) {
+            if ((*watch)->config_table == config_table) {
+                loc_cfg_watch* unwatched = *watch;
+                *watch = unwatched->next;
+                free(unwatched);
+            } else {
+                watch = &(*watch)->next;
+            }
+        }
+    }
+    pthread_mutex_unlock(&loc_cfg_store_mutex);
+}
+
+#ifdef __LOC_DEBUG__
+
+#define LOC_CFG_TEST_MAX_PARAMS 256
+
+/* A table with an entry for every name in a conf file, commented out or not,
+   the way loc_eng's gps_conf_table lists every known key */
+struct LocCfgTestTable {
+    loc_param_s_type mTable[LOC_CFG_TEST_MAX_PARAMS];
+    char mNames[LOC_CFG_TEST_MAX_PARAMS][LOC_MAX_PARAM_NAME];
+    char mValues[LOC_CFG_TEST_MAX_PARAMS][LOC_MAX_PARAM_STRING + 1];
+    uint8_t mSet[LOC_CFG_TEST_MAX_PARAMS];
+    uint32_t mLength;
+
+    LocCfgTestTable(const char* fileName) : mLength(0) {
+        char input_buf[LOC_MAX_PARAM_LINE];
+        loc_param_v_type config_value;
+        FILE* fp = fopen(fileName, "r");
+        while (NULL != fp && mLength < LOC_CFG_TEST_MAX_PARAMS &&
+               fgets(input_buf, LOC_MAX_PARAM_LINE, fp)) {
+            if (0 == loc_parse_conf_item(input_buf, &config_value)) {
+                char* name = config_value.param_name;
+                while ('#' == *name || ' ' == *name) {
+                    name++;
+                }
+                if ('\0' == *name || strchr(name, ' ') || strchr(name, '\n')) {
+                    continue;
+                }
+                strlcpy(mNames[mLength], name, sizeof(mNames[mLength]));
+                mTable[mLength].param_name = mNames[mLength];
+                mTable[mLength].param_ptr = mValues[mLength];
+                mTable[mLength].param_set = &mSet[mLength];
+                mTable[mLength].param_type = 's';
+                mLength++;
+            }
+        }
+        if (NULL != fp) {
+            fclose(fp);
+        }
+    }
+};
+
+/* loc_read_conf() as it was before the config store */
+static void loc_read_conf_legacy(const char* conf_file_name,
+                                 const loc_param_s_type* config_table,
+                                 uint32_t table_length)
 {
     FILE *conf_fp = NULL;
-    char *lasts;
-    loc_param_v_type config_value;
-    uint32_t i;
 
     if((conf_fp = fopen(conf_file_name, "r")) != NULL)
     {
-        LOC_LOGD("%s: using %s", __FUNCTION__, conf_file_name);
         if(table_length && config_table) {
             loc_read_conf_r(conf_fp, config_table, table_length);
             rewind(conf_fp);
@@ -395,6 +1214,272 @@ void loc_read_conf(const char* conf_file_name, const loc_param_s_type* config_ta
         loc_read_conf_r(conf_fp, loc_param_table, loc_param_num);
         fclose(conf_fp);
     }
-    /* Initialize logging mechanism with parsed data */
     loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
 }
+
+typedef void (*LocCfgTestRead)(const char*, const loc_param_s_type*, uint32_t);
+
+/* One HAL startup: loc_eng_read_config() reading gps.conf and sap.conf,
+   plus the gps.conf reads of LocDualContext, LocTimer and the scheduling
+   profile of each thread started */
+static void loc_cfg_test_startup(LocCfgTestRead read, const char* gpsConf,
+                                 const char* sapConf, LocCfgTestTable& gps,
+                                 LocCfgTestTable& sap, uint32_t threads)
+{
+    int value = 0;
+    loc_param_s_type small[] =
+    {
+        {"HAL_WORKER_THREADS",   &value, NULL, 'n'},
+        {"TIMER_BACKEND",        &value, NULL, 'n'},
+        {"LocMsgTask_SCHED_POLICY",   &value, NULL, 'n'},
+        {"LocMsgTask_SCHED_PRIORITY", &value, NULL, 'n'},
+    };
+
+    read(gpsConf, gps.mTable, gps.mLength);
+    read(sapConf, sap.mTable, sap.mLength);
+    read(gpsConf, small, 1);
+    read(gpsConf, small + 1, 1);
+    for (uint32_t i = 0; i < threads; i++) {
+        read(gpsConf, small + 2, 2);
+    }
+}
+
+/* forgets the parsed files, so the next read loads them again */
+static void loc_cfg_test_drop_store()
+{
+    pthread_mutex_lock(&loc_cfg_store_mutex);
+    while (NULL != loc_cfg_store) {
+        loc_cfg_file* file = loc_cfg_store;
+        loc_cfg_store = file->next;
+        loc_cfg_clear(file->map.buckets);
+        free(file->path);
+        free(file);
+    }
+    pthread_mutex_unlock(&loc_cfg_store_mutex);
+}
+
+static void loc_cfg_test_copy(const char* from, const char* to)
+{
+    char buf[4096];
+    size_t len;
+    FILE* in = fopen(from, "r");
+    FILE* out = fopen(to, "w");
+    while (NULL != in && NULL != out && (len = fread(buf, 1, sizeof(buf), in)) > 0) {
+        fwrite(buf, 1, len, out);
+    }
+    if (NULL != in) {
+        fclose(in);
+    }
+    if (NULL != out) {
+        fclose(out);
+    }
+}
+
+static double loc_cfg_test_now_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000000 + (double)now.tv_nsec / 1000;
+}
+
+// loc_update_conf() with the logging keys among the items of a caller's
+// table, which fill in both tables
+static int loc_cfg_test_update()
+{
+    int a = 0, b = 0, c = 0;
+    const loc_param_s_type table[] = {
+        {"A", &a, NULL, 'n'},
+        {"B", &b, NULL, 'n'},
+        {"C", &c, NULL, 'n'},
+    };
+    const char conf[] =
+        "A = 1\nLOG_TAG_LEVELS = LocSvc_other:5\nDEBUG_LEVEL = 5\nB = 2\n";
+    unsigned long debugLevel = DEBUG_LEVEL;
+    int mismatches = 0;
+
+    UTIL_UPDATE_CONF(conf, sizeof(conf) - 1, table);
+    if (1 != a || 2 != b || 0 != c || 5 != DEBUG_LEVEL || 5 != loc_logger.DEBUG_LEVEL ||
+        strcmp(LOG_TAG_LEVELS, "LocSvc_other:5") != 0) {
+        printf("mismatch loc_update_conf: A %d B %d C %d DEBUG_LEVEL %u/%lu "
+               "LOG_TAG_LEVELS %s\n", a, b, c, DEBUG_LEVEL, loc_logger.DEBUG_LEVEL,
+               LOG_TAG_LEVELS);
+        mismatches++;
+    }
+
+    char restore[64];
+    int len = snprintf(restore, sizeof(restore),
+                       "LOG_TAG_LEVELS = NULL\nDEBUG_LEVEL = %lu\n", debugLevel);
+    UTIL_UPDATE_CONF(restore, len, table);
+    return mismatches;
+}
+
+static volatile int loc_cfg_test_changes = 0;
+
+static void loc_cfg_test_changed(const loc_param_s_type* /*config_entry*/, void* /*user_data*/)
+{
+    loc_cfg_test_changes++;
+}
+
+static void loc_cfg_test_write(const char* path, const char* data)
+{
+    FILE* fp = fopen(path, "w");
+    if (NULL != fp) {
+        fputs(data, fp);
+        fclose(fp);
+    }
+}
+
+// a watched file rewritten in place with the same size, within the same
+// second, is reloaded all the same
+static int loc_cfg_test_watch(const char* dir)
+{
+    static int value = 0;
+    static const loc_param_s_type table[] = {
+        {"WATCHED", &value, NULL, 'n'},
+    };
+    char path[PATH_MAX];
+    int mismatches = 0;
+
+    snprintf(path, sizeof(path), "%s/watched.conf", dir);
+    loc_cfg_test_write(path, "WATCHED = 0x10000\n");
+    if (UTIL_WATCH_CONF(path, table, loc_cfg_test_changed, NULL) != 0) {
+        printf("mismatch loc_watch_conf: %s not watched\n", path);
+        return 1;
+    }
+    loc_cfg_test_write(path, "WATCHED = 0x20000\n");
+    for (int i = 0; i < 100 && 0 == loc_cfg_test_changes; i++) {
+        usleep(10000);
+    }
+    if (0x20000 != value || 1 != loc_cfg_test_changes) {
+        printf("mismatch same size rewrite: WATCHED 0x%x, %d callbacks\n",
+               value, loc_cfg_test_changes);
+        mismatches++;
+    }
+    loc_unwatch_conf(table);
+    unlink(path);
+    return mismatches;
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -O2 -I. -I../../../../system/core/include loc_cfg.cpp loc_cfg_blob.cpp loc_misc_utils.cpp loc_log.cpp LocThread.cpp -lpthread
+// test: ./a.out ../etc/gps.conf ../etc/sap.conf 1000
+// The values read through the store, last from the binary images, are
+// checked against the old parser.
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("usage: %s <gps.conf> <sap.conf> [startups] [threads]\n", argv[0]);
+        return 1;
+    }
+    const char* gpsConf = argv[1];
+    const char* sapConf = argv[2];
+    uint32_t startups = argc > 3 ? atoi(argv[3]) : 1000;
+    uint32_t threads = argc > 4 ? atoi(argv[4]) : 8;
+    LocCfgTestTable gps(gpsConf), sap(sapConf);
+    LocCfgTestTable gpsLegacy(gpsConf), sapLegacy(sapConf);
+
+    printf("%s: %u names, %s: %u names\n", gpsConf, gps.mLength, sapConf, sap.mLength);
+
+    // the first call of the store parses the files
+    double start = loc_cfg_test_now_us();
+    loc_cfg_test_startup(loc_read_conf, gpsConf, sapConf, gps, sap, threads);
+    printf("store, first startup:  %8.1f us\n", loc_cfg_test_now_us() - start);
+
+    start = loc_cfg_test_now_us();
+    for (uint32_t i = 0; i < startups; i++) {
+        loc_cfg_test_startup(loc_read_conf_legacy, gpsConf, sapConf,
+                             gpsLegacy, sapLegacy, threads);
+    }
+    double legacyUs = (loc_cfg_test_now_us() - start) / startups;
+
+    start = loc_cfg_test_now_us();
+    for (uint32_t i = 0; i < startups; i++) {
+        loc_cfg_test_startup(loc_read_conf, gpsConf, sapConf, gps, sap, threads);
+    }
+    double storeUs = (loc_cfg_test_now_us() - start) / startups;
+
+    start = loc_cfg_test_now_us();
+    for (uint32_t i = 0; i < startups; i++) {
+        loc_read_conf_legacy(gpsConf, gpsLegacy.mTable, gpsLegacy.mLength);
+        loc_read_conf_legacy(sapConf, sapLegacy.mTable, sapLegacy.mLength);
+    }
+    double legacyEngUs = (loc_cfg_test_now_us() - start) / startups;
+
+    start = loc_cfg_test_now_us();
+    for (uint32_t i = 0; i < startups; i++) {
+        loc_read_conf(gpsConf, gps.mTable, gps.mLength);
+        loc_read_conf(sapConf, sap.mTable, sap.mLength);
+    }
+    double storeEngUs = (loc_cfg_test_now_us() - start) / startups;
+
+    printf("loc_eng_read_config:   legacy %8.1f us  store %8.1f us\n",
+           legacyEngUs, storeEngUs);
+    printf("startup, %2u threads:   legacy %8.1f us  store %8.1f us\n",
+           threads, legacyUs, storeUs);
+
+    // boot, when nothing is parsed yet: text against binary images, on
+    // copies of the files so the images can be put next to them
+    char dir[] = "/tmp/loc_cfg_XXXXXX";
+    char gpsCopy[PATH_MAX], sapCopy[PATH_MAX], gpsImage[PATH_MAX], sapImage[PATH_MAX];
+    if (NULL == mkdtemp(dir)) {
+        printf("mkdtemp failed\n");
+        return 1;
+    }
+    snprintf(gpsCopy, sizeof(gpsCopy), "%s/gps.conf", dir);
+    snprintf(sapCopy, sizeof(sapCopy), "%s/sap.conf", dir);
+    snprintf(gpsImage, sizeof(gpsImage), "%s%s", gpsCopy, LOC_CFG_BLOB_SUFFIX);
+    snprintf(sapImage, sizeof(sapImage), "%s%s", sapCopy, LOC_CFG_BLOB_SUFFIX);
+    loc_cfg_test_copy(gpsConf, gpsCopy);
+    loc_cfg_test_copy(sapConf, sapCopy);
+
+    start = loc_cfg_test_now_us();
+    for (uint32_t i = 0; i < startups; i++) {
+        loc_cfg_test_drop_store();
+        loc_cfg_test_startup(loc_read_conf, gpsCopy, sapCopy, gps, sap, threads);
+    }
+    double textBootUs = (loc_cfg_test_now_us() - start) / startups;
+
+    if (loc_compile_conf(gpsCopy, gpsImage) != 0 || loc_compile_conf(sapCopy, sapImage) != 0) {
+        printf("loc_compile_conf failed\n");
+        return 1;
+    }
+    start = loc_cfg_test_now_us();
+    for (uint32_t i = 0; i < startups; i++) {
+        loc_cfg_test_drop_store();
+        loc_cfg_test_startup(loc_read_conf, gpsCopy, sapCopy, gps, sap, threads);
+    }
+    double imageBootUs = (loc_cfg_test_now_us() - start) / startups;
+
+    printf("boot, %2u threads:      legacy %8.1f us  text %8.1f us  image %8.1f us\n",
+           threads, legacyUs, textBootUs, imageBootUs);
+
+    unlink(gpsImage);
+    unlink(sapImage);
+    unlink(gpsCopy);
+    unlink(sapCopy);
+
+    int mismatches = loc_cfg_test_watch(dir);
+    rmdir(dir);
+
+    for (uint32_t i = 0; i < gps.mLength; i++) {
+        if (gps.mSet[i] != gpsLegacy.mSet[i] ||
+            strcmp(gps.mValues[i], gpsLegacy.mValues[i]) != 0) {
+            printf("mismatch %s: %s / %s\n", gps.mNames[i], gps.mValues[i],
+                   gpsLegacy.mValues[i]);
+            mismatches++;
+        }
+    }
+    for (uint32_t i = 0; i < sap.mLength; i++) {
+        if (sap.mSet[i] != sapLegacy.mSet[i] ||
+            strcmp(sap.mValues[i], sapLegacy.mValues[i]) != 0) {
+            printf("mismatch %s: %s / %s\n", sap.mNames[i], sap.mValues[i],
+                   sapLegacy.mValues[i]);
+            mismatches++;
+        }
+    }
+    mismatches += loc_cfg_test_update();
+    printf("mismatches %d\n", mismatches);
+    return mismatches ? 1 : 0;
+}
+
+#endif
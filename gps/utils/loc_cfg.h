@@ -47,6 +47,14 @@
 #define UTIL_READ_CONF(filename, config_table) \
     loc_read_conf((filename), (config_table), sizeof(config_table) / sizeof(config_table[0]))
 
+#define UTIL_LOOKUP_CONF(filename, config_table) \
+    loc_lookup_conf((filename), (config_table), sizeof(config_table) / sizeof(config_table[0]))
+
+#define UTIL_WATCH_CONF(filename, config_table, change_cb, user_data) \
+    loc_watch_conf((filename), (config_table), \
+                   sizeof(config_table) / sizeof(config_table[0]), \
+                   (change_cb), (user_data))
+
 /*=============================================================================
  *
  *                        MODULE TYPE DECLARATION
@@ -62,6 +70,10 @@ typedef struct
                                                  'f' for float */
 } loc_param_s_type;
 
+/* called after a watched entry is set to the new value of its file */
+typedef void (*loc_conf_change_cb)(const loc_param_s_type* config_entry,
+                                   void* user_data);
+
 /*=============================================================================
  *
  *                          MODULE EXTERNAL DATA
@@ -84,6 +96,16 @@ int loc_read_conf_r(FILE *conf_fp, const loc_param_s_type* config_table,
                     uint32_t table_length);
 int loc_update_conf(const char* conf_data, int32_t length,
                     const loc_param_s_type* config_table, uint32_t table_length);
+int loc_lookup_conf(const char* conf_file_name,
+                    const loc_param_s_type* config_table,
+                    uint32_t table_length);
+int loc_watch_conf(const char* conf_file_name,
+                   const loc_param_s_type* config_table,
+                   uint32_t table_length,
+                   loc_conf_change_cb change_cb,
+                   void* user_data);
+void loc_unwatch_conf(const loc_param_s_type* config_table);
+int loc_compile_conf(const char* conf_file_name, const char* blob_file_name);
 #ifdef __cplusplus
 }
 #endif
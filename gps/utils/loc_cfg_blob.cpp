@@ -0,0 +1,475 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Parsing of config files and their binary images, shared by loc_cfg.cpp
+// and the loc_cfg_compile build tool. Depends on nothing but libc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <loc_cfg_blob.h>
+
+/* trims leading and trailing white space in place, as loc_util_trim_space()
+   does, without its logging */
+static void loc_cfg_trim_space(char* org_string)
+{
+    char* scan_ptr = org_string;
+    char* write_ptr = org_string;
+    char* first_nonspace = NULL;
+    char* last_nonspace = NULL;
+
+    while (*scan_ptr) {
+        if (!isspace((unsigned char)*scan_ptr) && NULL == first_nonspace) {
+            first_nonspace = scan_ptr;
+        }
+        if (NULL != first_nonspace) {
+            *(write_ptr++) = *scan_ptr;
+            if (!isspace((unsigned char)*scan_ptr)) {
+                last_nonspace = write_ptr;
+            }
+        }
+        scan_ptr++;
+    }
+    if (NULL != last_nonspace) {
+        *last_nonspace = '\0';
+    }
+}
+
+/*===========================================================================
+FUNCTION loc_parse_conf_item
+
+DESCRIPTION
+   Splits a line of configuration item into its name and value, and parses
+   the numerical forms of the value. The line is tokenized in place, so the
+   name and string value point into input_buf.
+
+PARAMETERS:
+   input_buf : buffer contanis config item
+   config_value: parsed name and values
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: line is a config item
+  -1: line does not contain a name and a value
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_parse_conf_item(char* input_buf, loc_param_v_type* config_value)
+{
+    char *lasts;
+    memset(config_value, 0, sizeof(*config_value));
+
+    /* Separate variable and value */
+    config_value->param_name = strtok_r(input_buf, "=", &lasts);
+    /* skip lines that do not contain "=" */
+    if (NULL == config_value->param_name) {
+        return -1;
+    }
+    config_value->param_str_value = strtok_r(NULL, "=", &lasts);
+
+    /* skip lines that do not contain two operands */
+    if (NULL == config_value->param_str_value) {
+        return -1;
+    }
+
+    /* Trim leading and trailing spaces */
+    loc_cfg_trim_space(config_value->param_name);
+    loc_cfg_trim_space(config_value->param_str_value);
+
+    /* Parse numerical value */
+    if ((strlen(config_value->param_str_value) >=3) &&
+        (config_value->param_str_value[0] == '0') &&
+        (tolower(config_value->param_str_value[1]) == 'x'))
+    {
+        /* hex */
+        config_value->param_int_value = (int) strtol(&config_value->param_str_value[2],
+                                                     (char**) NULL, 16);
+    }
+    else {
+        config_value->param_double_value = (double) atof(config_value->param_str_value); /* float */
+        config_value->param_int_value = atoi(config_value->param_str_value); /* dec */
+    }
+
+    return 0;
+}
+
+/* 32 bit FNV-1a */
+static uint32_t loc_cfg_hash(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+loc_cfg_item* loc_cfg_find(loc_cfg_item* const* buckets, const char* name)
+{
+    uint32_t hash = loc_cfg_hash(name);
+    loc_cfg_item* item = buckets[hash % LOC_CFG_HASH_BUCKETS];
+    while (NULL != item &&
+           (item->hash != hash || strcmp(item->name, name) != 0)) {
+        item = item->next;
+    }
+    return item;
+}
+
+void loc_cfg_clear(loc_cfg_item** buckets)
+{
+    for (uint32_t i = 0; i < LOC_CFG_HASH_BUCKETS; i++) {
+        while (NULL != buckets[i]) {
+            loc_cfg_item* item = buckets[i];
+            buckets[i] = item->next;
+            free(item);
+        }
+    }
+}
+
+/* sets the values of an item, adding the item if the map has none of that
+   name; -1 if out of memory */
+int loc_cfg_add_item(loc_cfg_map* map, const char* name, const char* str_value,
+                     int int_value, double double_value)
+{
+    loc_cfg_item* item = loc_cfg_find(map->buckets, name);
+    if (NULL == item) {
+        item = (loc_cfg_item*)malloc(sizeof(loc_cfg_item));
+        if (NULL == item) {
+            return -1;
+        }
+        snprintf(item->name, sizeof(item->name), "%s", name);
+        item->hash = loc_cfg_hash(item->name);
+        item->next = map->buckets[item->hash % LOC_CFG_HASH_BUCKETS];
+        map->buckets[item->hash % LOC_CFG_HASH_BUCKETS] = item;
+        map->num_items++;
+    }
+    snprintf(item->str_value, sizeof(item->str_value), "%s", str_value);
+    item->int_value = int_value;
+    item->double_value = double_value;
+    return 0;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_parse
+
+DESCRIPTION
+   Parses every config item of a mapped file into a hash map. When a name
+   shows up more than once, the last line wins.
+
+PARAMETERS:
+   map: hash map to fill
+   data: file content
+   size: size of the file content
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: parsed
+  -1: out of memory, the map holds the items parsed so far
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_cfg_parse(loc_cfg_map* map, const char* data, size_t size)
+{
+    char input_buf[LOC_MAX_PARAM_LINE];
+    loc_param_v_type config_value;
+    const char* end = data + size;
+
+    while (data < end) {
+        const char* eol = (const char*)memchr(data, '\n', end - data);
+        if (NULL == eol) {
+            eol = end;
+        }
+        size_t len = eol - data;
+        if (len >= LOC_MAX_PARAM_LINE) {
+            len = LOC_MAX_PARAM_LINE - 1;
+        }
+        memcpy(input_buf, data, len);
+        input_buf[len] = '\0';
+        data = eol + 1;
+
+        if (0 != loc_parse_conf_item(input_buf, &config_value) ||
+            '#' == config_value.param_name[0]) {
+            continue;
+        }
+
+        if (0 != loc_cfg_add_item(map, config_value.param_name,
+                                  config_value.param_str_value,
+                                  config_value.param_int_value,
+                                  config_value.param_double_value)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*=============================================================================
+ *
+ * Binary config images, compiled from a config file at build time by
+ * loc_cfg_compile, and installed next to it as <file>.bin. The image holds
+ * the items with their values already converted, so loading it skips the
+ * text parsing. It records the size and a hash of the text it was
+ * compiled from; if the text file differs, the image is stale and the
+ * text is parsed instead.
+ *
+ *   loc_cfg_blob_header
+ *   loc_cfg_blob_item[num_items]
+ *   strings_size bytes of NUL terminated names and string values
+ *
+ *============================================================================*/
+
+#define LOC_CFG_BLOB_MAGIC   0x4246434c /* "LCFB" read little endian */
+#define LOC_CFG_BLOB_VERSION 1
+
+typedef struct loc_cfg_blob_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t source_size;
+    uint32_t num_items;
+    uint32_t strings_size;
+    uint32_t reserved;
+    uint64_t source_hash;
+} loc_cfg_blob_header;
+
+typedef struct loc_cfg_blob_item
+{
+    uint32_t name_offset;
+    uint32_t str_offset;
+    int32_t int_value;
+    uint32_t reserved;
+    double double_value;
+} loc_cfg_blob_item;
+
+/* FNV-1a style hash of the file content, taken 8 bytes at a time so that
+   checking an image costs much less than parsing the text */
+static uint64_t loc_cfg_hash_data(const char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    uint64_t word;
+    size_t i = 0;
+    for (; i + sizeof(word) <= size; i += sizeof(word)) {
+        memcpy(&word, data + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_blob_read
+
+DESCRIPTION
+   Fills a hash map from the binary image of a config file, if the image
+   is valid and was compiled from the current text of the file.
+
+PARAMETERS:
+   map: hash map to fill
+   blob: content of the binary image
+   blob_size: size of the binary image
+   data: text content of the config file
+   size: size of the text content
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   LOC_CFG_BLOB_OK: loaded from the binary image
+   LOC_CFG_BLOB_INVALID, LOC_CFG_BLOB_STALE or LOC_CFG_BLOB_NO_MEM: no
+   usable image, the text is to be parsed
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_cfg_blob_read(loc_cfg_map* map, const void* blob, size_t blob_size,
+                      const char* data, size_t size)
+{
+    if (blob_size < sizeof(loc_cfg_blob_header)) {
+        return LOC_CFG_BLOB_INVALID;
+    }
+
+    const loc_cfg_blob_header* header = (const loc_cfg_blob_header*)blob;
+    const loc_cfg_blob_item* items = (const loc_cfg_blob_item*)(header + 1);
+    const char* strings = (const char*)(items + header->num_items);
+
+    if (header->magic != LOC_CFG_BLOB_MAGIC ||
+        header->version != LOC_CFG_BLOB_VERSION ||
+        header->header_size != sizeof(loc_cfg_blob_header) ||
+        header->num_items > blob_size / sizeof(loc_cfg_blob_item) ||
+        (uint64_t)sizeof(loc_cfg_blob_header) +
+        (uint64_t)header->num_items * sizeof(loc_cfg_blob_item) +
+        header->strings_size != (uint64_t)blob_size ||
+        (header->strings_size > 0 && strings[header->strings_size - 1] != '\0')) {
+        return LOC_CFG_BLOB_INVALID;
+    }
+    if (header->source_size != size ||
+        header->source_hash != loc_cfg_hash_data(data, size)) {
+        return LOC_CFG_BLOB_STALE;
+    }
+
+    for (uint32_t i = 0; i < header->num_items; i++) {
+        if (items[i].name_offset >= header->strings_size ||
+            items[i].str_offset >= header->strings_size) {
+            return LOC_CFG_BLOB_INVALID;
+        }
+        if (0 != loc_cfg_add_item(map, strings + items[i].name_offset,
+                                  strings + items[i].str_offset,
+                                  items[i].int_value, items[i].double_value)) {
+            return LOC_CFG_BLOB_NO_MEM;
+        }
+    }
+    return LOC_CFG_BLOB_OK;
+}
+
+/*===========================================================================
+FUNCTION loc_compile_conf
+
+DESCRIPTION
+   Compiles a configuration file into the binary image that loc_read_conf()
+   loads in place of parsing the text. Used by the loc_cfg_compile build
+   tool; the image is to be installed as <conf_file_name>.bin.
+
+PARAMETERS:
+   conf_file_name: configuration file to compile
+   blob_file_name: binary image to write
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: image written
+  -1: error, with errno set
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_compile_conf(const char* conf_file_name, const char* blob_file_name)
+{
+    int ret = -1;
+    struct stat st;
+    loc_cfg_map map;
+    memset(&map, 0, sizeof(map));
+
+    int fd = open(conf_file_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return ret;
+    }
+    void* data = NULL;
+    if (st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (MAP_FAILED == data) {
+        return ret;
+    }
+
+    loc_cfg_blob_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LOC_CFG_BLOB_MAGIC;
+    header.version = LOC_CFG_BLOB_VERSION;
+    header.header_size = sizeof(loc_cfg_blob_header);
+    header.source_size = st.st_size;
+    if (NULL != data) {
+        int parsed = loc_cfg_parse(&map, (const char*)data, st.st_size);
+        header.source_hash = loc_cfg_hash_data((const char*)data, st.st_size);
+        munmap(data, st.st_size);
+        if (0 != parsed) {
+            loc_cfg_clear(map.buckets);
+            errno = ENOMEM;
+            return ret;
+        }
+    } else {
+        header.source_hash = loc_cfg_hash_data(NULL, 0);
+    }
+    header.num_items = map.num_items;
+
+    FILE* blob_fp = fopen(blob_file_name, "wb");
+    if (NULL != blob_fp) {
+        /* the strings follow the items, in the order of the items */
+        for (uint32_t b = 0; b < LOC_CFG_HASH_BUCKETS; b++) {
+            for (loc_cfg_item* item = map.buckets[b]; NULL != item; item = item->next) {
+                header.strings_size += strlen(item->name) + strlen(item->str_value) + 2;
+            }
+        }
+        bool written = fwrite(&header, sizeof(header), 1, blob_fp) == 1;
+
+        uint32_t offset = 0;
+        for (uint32_t b = 0; b < LOC_CFG_HASH_BUCKETS; b++) {
+            for (loc_cfg_item* item = map.buckets[b]; NULL != item; item = item->next) {
+                loc_cfg_blob_item blob_item;
+                memset(&blob_item, 0, sizeof(blob_item));
+                blob_item.name_offset = offset;
+                offset += strlen(item->name) + 1;
+                blob_item.str_offset = offset;
+                offset += strlen(item->str_value) + 1;
+                blob_item.int_value = item->int_value;
+                blob_item.double_value = item->double_value;
+                written = written && fwrite(&blob_item, sizeof(blob_item), 1, blob_fp) == 1;
+            }
+        }
+        for (uint32_t b = 0; b < LOC_CFG_HASH_BUCKETS; b++) {
+            for (loc_cfg_item* item = map.buckets[b]; NULL != item; item = item->next) {
+                written = written &&
+                    fwrite(item->name, strlen(item->name) + 1, 1, blob_fp) == 1 &&
+                    fwrite(item->str_value, strlen(item->str_value) + 1, 1, blob_fp) == 1;
+            }
+        }
+
+        if (fclose(blob_fp) == 0 && written) {
+            ret = 0;
+        } else {
+            int err = errno;
+            unlink(blob_file_name);
+            errno = err;
+        }
+    }
+
+    loc_cfg_clear(map.buckets);
+    return ret;
+}
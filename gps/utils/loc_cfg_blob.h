@@ -0,0 +1,88 @@
+/* Copyright (c) 2011-2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_CFG_BLOB_H
+#define LOC_CFG_BLOB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <loc_cfg.h>
+
+/*=============================================================================
+ *
+ * Parsing of config files into a hash map of name -> typed value, and the
+ * binary images compiled from them. Internal to loc_cfg.cpp and the
+ * loc_cfg_compile build tool; this part depends on nothing but libc, so
+ * the tool builds for the host.
+ *
+ *============================================================================*/
+
+#define LOC_CFG_HASH_BUCKETS 64
+#define LOC_CFG_BLOB_SUFFIX  ".bin"
+
+/* loc_cfg_blob_read() results */
+#define LOC_CFG_BLOB_OK        0
+#define LOC_CFG_BLOB_INVALID  -1
+#define LOC_CFG_BLOB_STALE    -2
+#define LOC_CFG_BLOB_NO_MEM   -3
+
+typedef struct loc_param_v_type
+{
+    char* param_name;
+    char* param_str_value;
+    int param_int_value;
+    double param_double_value;
+}loc_param_v_type;
+
+typedef struct loc_cfg_item
+{
+    struct loc_cfg_item* next;
+    uint32_t hash;
+    int int_value;
+    double double_value;
+    char name[LOC_MAX_PARAM_LINE];
+    char str_value[LOC_MAX_PARAM_STRING + 1];
+} loc_cfg_item;
+
+typedef struct loc_cfg_map
+{
+    loc_cfg_item* buckets[LOC_CFG_HASH_BUCKETS];
+    uint32_t num_items;
+} loc_cfg_map;
+
+int loc_parse_conf_item(char* input_buf, loc_param_v_type* config_value);
+loc_cfg_item* loc_cfg_find(loc_cfg_item* const* buckets, const char* name);
+void loc_cfg_clear(loc_cfg_item** buckets);
+int loc_cfg_add_item(loc_cfg_map* map, const char* name, const char* str_value,
+                     int int_value, double double_value);
+int loc_cfg_parse(loc_cfg_map* map, const char* data, size_t size);
+int loc_cfg_blob_read(loc_cfg_map* map, const void* blob, size_t blob_size,
+                      const char* data, size_t size);
+
+#endif /* LOC_CFG_BLOB_H */
@@ -31,6 +31,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <time.h>
 #include "loc_log.h"
@@ -42,6 +45,8 @@
 #include "platform_lib_includes.h"
 
 #define  BUFFER_SIZE  120
+#define  LOC_LOG_MAX_TAG_LEVELS  16
+#define  LOC_LOG_MAX_TAG_LEN     48
 
 // Logging Improvements
 const char *loc_logger_boolStr[]={"False","True"};
@@ -57,6 +62,19 @@ const char EXIT_ERROR_TAG[]  = "Exiting with error";
 /* Logging Mechanism */
 loc_logger_s_type loc_logger;
 
+/* Levels set per LOG_TAG by LOG_TAG_LEVELS, and the call sites that have
+   cached a level, so they can be updated when the levels change */
+typedef struct loc_log_tag_level_s
+{
+   char           tag[LOC_LOG_MAX_TAG_LEN];
+   unsigned char  level;
+} loc_log_tag_level_s_type;
+
+static pthread_mutex_t loc_log_sites_mutex = PTHREAD_MUTEX_INITIALIZER;
+static loc_log_site_s_type* loc_log_sites = NULL;
+static loc_log_tag_level_s_type loc_log_tag_levels[LOC_LOG_MAX_TAG_LEVELS];
+static int loc_log_tag_level_num = 0;
+
 /* Get names from value */
 const char* loc_get_name_from_mask(const loc_name_val_s_type table[], size_t table_size, long mask)
 {
@@ -75,6 +93,18 @@ const char* loc_get_name_from_mask(const loc_name_val_s_type table[], size_t tab
 const char* loc_get_name_from_val(const loc_name_val_s_type table[], size_t table_size, long value)
 {
    size_t i;
+
+   /* Tables mostly list an enum in order, with consecutive values, so the
+      entry for value is found at value - table[0].val without a scan */
+   if (table_size > 0)
+   {
+      i = (unsigned long) value - (unsigned long) table[0].val;
+      if (i < table_size && table[i].val == value)
+      {
+         return table[i].name;
+      }
+   }
+
    for (i = 0; i < table_size; i++)
    {
       if (table[i].val == (long) value)
@@ -85,14 +115,19 @@ const char* loc_get_name_from_val(const loc_name_val_s_type table[], size_t tabl
    return UNKNOWN_STR;
 }
 
+/* in order of value, so loc_get_name_from_val() can index it */
 static const loc_name_val_s_type loc_msg_q_status[] =
 {
-    NAME_VAL( eMSG_Q_SUCCESS ),
-    NAME_VAL( eMSG_Q_FAILURE_GENERAL ),
-    NAME_VAL( eMSG_Q_INVALID_PARAMETER ),
-    NAME_VAL( eMSG_Q_INVALID_HANDLE ),
+    NAME_VAL( eMSG_Q_INSUFFICIENT_BUFFER ),
     NAME_VAL( eMSG_Q_UNAVAILABLE_RESOURCE ),
-    NAME_VAL( eMSG_Q_INSUFFICIENT_BUFFER )
+    NAME_VAL( eMSG_Q_INVALID_HANDLE ),
+    NAME_VAL( eMSG_Q_INVALID_PARAMETER ),
+    NAME_VAL( eMSG_Q_FAILURE_GENERAL ),
+    NAME_VAL( eMSG_Q_SUCCESS ),
+    NAME_VAL( eMSG_Q_HIGH_WATER_MARK ),
+    NAME_VAL( eMSG_Q_DROPPED_OLDEST ),
+    NAME_VAL( eMSG_Q_COALESCED ),
+    NAME_VAL( eMSG_Q_SUPERSEDED )
 };
 static const size_t loc_msg_q_status_num = LOC_TABLE_SIZE(loc_msg_q_status);
 
@@ -171,20 +206,99 @@ RETURN VALUE
 ===========================================================================*/
 char *loc_get_time(char *time_string, size_t buf_size)
 {
+   /* HH:MM:SS of the second this thread last formatted, which saves the
+      localtime_r() and strftime() of every call within the same second */
+   static __thread time_t hms_second = (time_t) -1;
+   static __thread char hms_string[16];
    struct timeval now;     /* sec and usec     */
-   struct tm now_tm;       /* broken-down time */
-   char hms_string[80];    /* HH:MM:SS         */
+   char time_buf[sizeof(hms_string) + 4];
+   size_t len;
+   int msec;
 
    gettimeofday(&now, NULL);
-   localtime_r(&now.tv_sec, &now_tm);
+   if (now.tv_sec != hms_second)
+   {
+      struct tm now_tm;    /* broken-down time */
+      localtime_r(&now.tv_sec, &now_tm);
+      strftime(hms_string, sizeof hms_string, "%H:%M:%S", &now_tm);
+      hms_second = now.tv_sec;
+   }
 
-   strftime(hms_string, sizeof hms_string, "%H:%M:%S", &now_tm);
-   snprintf(time_string, buf_size, "%s.%03d", hms_string, (int) (now.tv_usec / 1000));
+   len = strlen(hms_string);
+   memcpy(time_buf, hms_string, len);
+   msec = (int) (now.tv_usec / 1000);
+   time_buf[len++] = '.';
+   time_buf[len++] = '0' + msec / 100;
+   time_buf[len++] = '0' + msec / 10 % 10;
+   time_buf[len++] = '0' + msec % 10;
+   time_buf[len] = '\0';
+   strlcpy(time_string, time_buf, buf_size);
 
    return time_string;
 }
 
 
+/*===========================================================================
+FUNCTION loc_log_tag_level
+
+DESCRIPTION
+   Gives the level a LOG_TAG logs at: its LOG_TAG_LEVELS entry if it has
+   one, otherwise DEBUG_LEVEL. A NULL tag has no entry.
+
+DEPENDENCIES
+   Called with loc_log_sites_mutex held
+
+RETURN VALUE
+   Level 1 (errors) to 5 (verbose), 0 when logging is off for the tag
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static unsigned char loc_log_tag_level(const char* tag)
+{
+   unsigned long level = loc_logger.DEBUG_LEVEL;
+   int i;
+
+   for (i = 0; NULL != tag && i < loc_log_tag_level_num; i++) {
+      if (0 == strcmp(loc_log_tag_levels[i].tag, tag)) {
+         level = loc_log_tag_levels[i].level;
+         break;
+      }
+   }
+#ifdef TARGET_BUILD_VARIANT_USER
+   // force user builds to 2 or less
+   if (level > 2 && level <= 5) {
+       level = 2;
+   }
+#endif
+   return (level >= 1 && level <= 5) ? (unsigned char)level : 0;
+}
+
+/*===========================================================================
+FUNCTION loc_log_update_sites
+
+DESCRIPTION
+   Refreshes the cached level of every call site that has logged so far
+
+DEPENDENCIES
+   Called with loc_log_sites_mutex held
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_log_update_sites(void)
+{
+   loc_log_site_s_type* site;
+
+   for (site = loc_log_sites; NULL != site; site = site->next) {
+      __atomic_store_n(&site->level, loc_log_tag_level(site->tag),
+                       __ATOMIC_RELAXED);
+   }
+}
+
 /*===========================================================================
 FUNCTION loc_logger_init
 
@@ -210,6 +324,111 @@ void loc_logger_init(unsigned long debug, unsigned long timestamp)
    }
 #endif
    loc_logger.TIMESTAMP   = timestamp;
+
+   pthread_mutex_lock(&loc_log_sites_mutex);
+   loc_log_update_sites();
+   pthread_mutex_unlock(&loc_log_sites_mutex);
+}
+
+/*===========================================================================
+FUNCTION loc_log_site_resolve
+
+DESCRIPTION
+   Looks up the level of a call site's LOG_TAG, caches it in the site and
+   registers the site to be updated when levels change. Called by the
+   LOC_LOGx macros the first time a call site runs.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The level of the site's tag, 0 when its logging is off
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+int loc_log_site_resolve(loc_log_site_s_type* site)
+{
+   unsigned char level;
+
+   pthread_mutex_lock(&loc_log_sites_mutex);
+   if (!site->registered) {
+      site->registered = 1;
+      site->next = loc_log_sites;
+      loc_log_sites = site;
+   }
+   level = loc_log_tag_level(site->tag);
+   __atomic_store_n(&site->level, level, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&loc_log_sites_mutex);
+
+   return level;
+}
+
+/*===========================================================================
+FUNCTION loc_log_set_tag_levels
+
+DESCRIPTION
+   Sets the log levels of individual LOG_TAGs, overriding DEBUG_LEVEL for
+   them, and updates every call site already cached. The list has the
+   form "LocSvc_utils_q:5, LocSvc_eng:3"; an empty list clears the
+   overrides.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_log_set_tag_levels(const char* tag_levels)
+{
+   loc_log_tag_level_s_type levels[LOC_LOG_MAX_TAG_LEVELS];
+   int num = 0;
+   const char* p = (NULL == tag_levels) ? "" : tag_levels;
+
+   while (*p && num < LOC_LOG_MAX_TAG_LEVELS) {
+      size_t len = 0;
+      char* end = NULL;
+      long level;
+
+      while (isspace((unsigned char)*p) || ',' == *p) {
+         p++;
+      }
+      while (p[len] && ':' != p[len] && ',' != p[len] &&
+             !isspace((unsigned char)p[len])) {
+         len++;
+      }
+      if (0 == len) {
+         break;
+      }
+      const char* colon = p + len;
+      while (isspace((unsigned char)*colon)) {
+         colon++;
+      }
+      if (':' == *colon && len < LOC_LOG_MAX_TAG_LEN &&
+          (level = strtol(colon + 1, &end, 10), end != colon + 1) &&
+          level >= 0 && level <= 5) {
+         memcpy(levels[num].tag, p, len);
+         levels[num].tag[len] = '\0';
+         levels[num].level = (unsigned char)level;
+         num++;
+      } else {
+         LOC_LOGE("%s: ignoring %.*s, not of the form TAG:LEVEL", __func__,
+                  (int)len, p);
+      }
+      p = (NULL != end) ? end : colon;
+      while (*p && ',' != *p) {
+         p++;
+      }
+   }
+
+   pthread_mutex_lock(&loc_log_sites_mutex);
+   memcpy(loc_log_tag_levels, levels, num * sizeof(levels[0]));
+   loc_log_tag_level_num = num;
+   loc_log_update_sites();
+   pthread_mutex_unlock(&loc_log_sites_mutex);
 }
 
 
@@ -241,3 +460,214 @@ char * get_timestamp(char *str, unsigned long buf_size)
   return str;
 }
 
+
+#ifdef __LOC_DEBUG__
+
+#include <stdint.h>
+
+/* loc_get_name_from_val() as it was, scanning every table */
+static const char* loc_get_name_from_val_linear(const loc_name_val_s_type table[],
+                                                size_t table_size, long value)
+{
+   size_t i;
+   for (i = 0; i < table_size; i++)
+   {
+      if (table[i].val == (long) value)
+      {
+         return table[i].name;
+      }
+   }
+   return UNKNOWN_STR;
+}
+
+/* loc_get_time() as it was, converting and formatting every call */
+static char *loc_get_time_uncached(char *time_string, size_t buf_size)
+{
+   struct timeval now;     /* sec and usec     */
+   struct tm now_tm;       /* broken-down time */
+   char hms_string[80];    /* HH:MM:SS         */
+
+   gettimeofday(&now, NULL);
+   localtime_r(&now.tv_sec, &now_tm);
+
+   strftime(hms_string, sizeof hms_string, "%H:%M:%S", &now_tm);
+   snprintf(time_string, buf_size, "%s.%03d", hms_string, (int) (now.tv_usec / 1000));
+
+   return time_string;
+}
+
+/* the shapes of the tables in loc_core_log.cpp: from 0, from -1, from 1,
+   and one with a hole, which takes the fallback scan */
+static const loc_name_val_s_type loc_log_test_from_minus_1[] =
+{
+    { "AGPS_TYPE_INVALID", -1 }, { "AGPS_TYPE_ANY", 0 }, { "AGPS_TYPE_SUPL", 1 },
+    { "AGPS_TYPE_C2K", 2 }, { "AGPS_TYPE_WWAN_ANY", 3 }
+};
+static const loc_name_val_s_type loc_log_test_from_1[] =
+{
+    { "GPS_REQUEST_AGPS_DATA_CONN", 1 }, { "GPS_RELEASE_AGPS_DATA_CONN", 2 },
+    { "GPS_AGPS_DATA_CONNECTED", 3 }, { "GPS_AGPS_DATA_CONN_DONE", 4 },
+    { "GPS_AGPS_DATA_CONN_FAILED", 5 }
+};
+static const loc_name_val_s_type loc_log_test_holes[] =
+{
+    { "GPS_NI_RESPONSE_ACCEPT", 1 }, { "GPS_NI_RESPONSE_DENY", 2 },
+    { "GPS_NI_RESPONSE_DENY", 2 }, { "GPS_ENC_UNKNOWN", -1 }
+};
+
+typedef struct
+{
+   const char* name;
+   const loc_name_val_s_type* table;
+   size_t table_size;
+} loc_log_test_table;
+
+static const loc_log_test_table loc_log_test_tables[] =
+{
+    { "loc_msg_q_status", loc_msg_q_status, loc_msg_q_status_num },
+    { "target_name", target_name, target_name_num },
+    { "from -1", loc_log_test_from_minus_1, LOC_TABLE_SIZE(loc_log_test_from_minus_1) },
+    { "from 1", loc_log_test_from_1, LOC_TABLE_SIZE(loc_log_test_from_1) },
+    { "with holes", loc_log_test_holes, LOC_TABLE_SIZE(loc_log_test_holes) },
+};
+
+/* called through pointers, so the compiler cannot hoist the lookups */
+typedef const char* (*loc_log_test_lookup)(const loc_name_val_s_type[], size_t, long);
+static loc_log_test_lookup volatile loc_log_test_linear = loc_get_name_from_val_linear;
+static loc_log_test_lookup volatile loc_log_test_indexed = loc_get_name_from_val;
+
+static uint64_t loc_log_test_now_ns()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -O2 -I. -I../../../../system/core/include loc_log.cpp loc_target.cpp loc_misc_utils.cpp -lpthread
+// test: ./a.out 1000000
+int main(int argc, char** argv)
+{
+   int rounds = argc > 1 ? atoi(argv[1]) : 1000000;
+   int mismatches = 0;
+   size_t t, i;
+   long v;
+
+   for (t = 0; t < LOC_TABLE_SIZE(loc_log_test_tables); t++)
+   {
+      const loc_log_test_table* test = &loc_log_test_tables[t];
+      long low = test->table[0].val, high = test->table[0].val;
+      loc_log_test_lookup linear = loc_log_test_linear;
+      loc_log_test_lookup indexed = loc_log_test_indexed;
+      uint64_t start, linear_ns, indexed_ns;
+      int r;
+
+      for (i = 0; i < test->table_size; i++)
+      {
+         if (test->table[i].val < low) low = test->table[i].val;
+         if (test->table[i].val > high) high = test->table[i].val;
+      }
+      // every value in the table and one past either end, by both lookups
+      for (v = low - 1; v <= high + 1; v++)
+      {
+         if (strcmp(loc_get_name_from_val(test->table, test->table_size, v),
+                    loc_get_name_from_val_linear(test->table, test->table_size, v)))
+         {
+            printf("mismatch: %s %ld\n", test->name, v);
+            mismatches++;
+         }
+      }
+
+      start = loc_log_test_now_ns();
+      for (r = 0; r < rounds; r++)
+      {
+         for (i = 0; i < test->table_size; i++)
+         {
+            linear(test->table, test->table_size, test->table[i].val);
+         }
+      }
+      linear_ns = loc_log_test_now_ns() - start;
+
+      start = loc_log_test_now_ns();
+      for (r = 0; r < rounds; r++)
+      {
+         for (i = 0; i < test->table_size; i++)
+         {
+            indexed(test->table, test->table_size, test->table[i].val);
+         }
+      }
+      indexed_ns = loc_log_test_now_ns() - start;
+
+      printf("%-16s %2zu entries: scan %.2f ns, indexed %.2f ns\n", test->name,
+             test->table_size, (double)linear_ns / rounds / test->table_size,
+             (double)indexed_ns / rounds / test->table_size);
+   }
+
+   {
+      char cached[16], uncached[16];
+      uint64_t start, uncached_ns, cached_ns;
+      int r;
+
+      // the two may straddle a millisecond, so compare the whole seconds
+      loc_get_time(cached, sizeof(cached));
+      loc_get_time_uncached(uncached, sizeof(uncached));
+      if (strncmp(cached, uncached, 8))
+      {
+         printf("mismatch: loc_get_time %s vs %s\n", cached, uncached);
+         mismatches++;
+      }
+      loc_get_time(cached, 6);
+      if (strlen(cached) != 5)
+      {
+         printf("mismatch: loc_get_time not cut to 5 chars: %s\n", cached);
+         mismatches++;
+      }
+
+      start = loc_log_test_now_ns();
+      for (r = 0; r < rounds; r++)
+      {
+         loc_get_time_uncached(uncached, sizeof(uncached));
+      }
+      uncached_ns = loc_log_test_now_ns() - start;
+
+      start = loc_log_test_now_ns();
+      for (r = 0; r < rounds; r++)
+      {
+         loc_get_time(cached, sizeof(cached));
+      }
+      cached_ns = loc_log_test_now_ns() - start;
+
+      printf("loc_get_time: uncached %.1f ns, cached %.1f ns (%s)\n",
+             (double)uncached_ns / rounds, (double)cached_ns / rounds, cached);
+   }
+
+   {
+      // a NULL LOG_TAG matches no LOG_TAG_LEVELS entry
+      // registered with the other sites, so it must outlive this block
+      static loc_log_site_s_type site = { LOC_LOG_SITE_UNRESOLVED, 0, NULL, NULL };
+      unsigned long debug_level = loc_logger.DEBUG_LEVEL;
+      int level;
+
+      loc_logger.DEBUG_LEVEL = 2;
+      loc_log_set_tag_levels("LocSvc_eng:4, LocSvc_utils_q:5");
+      level = loc_log_site_resolve(&site);
+      if (2 != level)
+      {
+         printf("mismatch: NULL tag level %d, not DEBUG_LEVEL 2\n", level);
+         mismatches++;
+      }
+#undef LOG_TAG
+#define LOG_TAG NULL
+      LOC_LOGE("%s: logged from a NULL tag site", __func__);
+      LOC_LOGD("%s: not logged from a NULL tag site", __func__);
+#undef LOG_TAG
+#define LOG_TAG "GPS_UTILS"
+      loc_log_set_tag_levels("");
+      loc_logger.DEBUG_LEVEL = debug_level;
+   }
+
+   printf("mismatches %d\n", mismatches);
+   return mismatches != 0;
+}
+
+#endif /* __LOC_DEBUG__ */
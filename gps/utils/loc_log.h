@@ -54,7 +54,8 @@ typedef struct
 
 #define LOC_TABLE_SIZE(table) (sizeof(table)/sizeof((table)[0]))
 
-/* Get names from value */
+/* Get names from value. Tables listed in order of consecutive values are
+   looked up by index, others are scanned */
 const char* loc_get_name_from_mask(const loc_name_val_s_type table[], size_t table_size, long mask);
 const char* loc_get_name_from_val(const loc_name_val_s_type table[], size_t table_size, long value);
 const char* loc_get_msg_q_status(int status);
@@ -0,0 +1,863 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_log_ring"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <log_util.h>
+#include <LocThread.h>
+#include "platform_lib_includes.h"
+
+// Binary log rings. With LOG_RING_KB set in gps.conf, the LOC_LOGx macros
+// no longer format their message: each thread copies the format pointer,
+// the arguments, its tid and the monotonic time into its own ring, with
+// no lock and no syscall. The LocLogFlush thread formats the records and
+// hands them to the Android logger every LOC_LOG_RING_FLUSH_MS, and
+// loc_log_ring_flush() does the same on demand, e.g. before a dump.
+// A ring that is full drops new records, and the drops are logged when
+// the ring is next flushed. With the rings turned off, LocLogFlush waits
+// until they are turned on again.
+
+#define LOC_LOG_RING_MIN_KB     4
+#define LOC_LOG_RING_MAX_KB     1024
+// bytes kept of each %s argument; the length recorded for a string that
+// was cut short has LOC_LOG_RING_STR_CUT set, and it is printed with "..."
+#define LOC_LOG_RING_MAX_STR    96
+#define LOC_LOG_RING_STR_CUT    0x8000
+// bytes of arguments kept per record
+#define LOC_LOG_RING_MAX_ARGS   512
+#define LOC_LOG_RING_FLUSH_MS   100
+// arguments kept per format, and formats kept per thread
+#define LOC_LOG_RING_MAX_CONVS  22
+#define LOC_LOG_RING_FORMATS    64
+#define LOC_LOG_RING_LINE       1024
+
+// Argument types, as told by the conversions of the format
+enum LocLogArg {
+    LOC_LOG_ARG_NONE,
+    LOC_LOG_ARG_INT,
+    LOC_LOG_ARG_LONG,
+    LOC_LOG_ARG_LLONG,
+    LOC_LOG_ARG_SIZE,
+    LOC_LOG_ARG_INTMAX,
+    LOC_LOG_ARG_PTRDIFF,
+    LOC_LOG_ARG_DOUBLE,
+    LOC_LOG_ARG_LDOUBLE,
+    LOC_LOG_ARG_PTR,
+    LOC_LOG_ARG_STR,
+    LOC_LOG_ARG_COUNT,   // %n, nothing to format
+};
+
+// One conversion of a format: [start, end) of its spec, the number of
+// '*' int arguments before its own argument, and the type of that one.
+struct LocLogConv {
+    const char* mStart;
+    const char* mEnd;
+    int mStars;
+    LocLogArg mArg;
+};
+
+// Finds the next conversion at or after fmt; returns false at the end of
+// the format. "%%" is a conversion with no argument.
+static bool locLogNextConv(const char* fmt, LocLogConv& conv) {
+    const char* p = strchr(fmt, '%');
+    if (NULL == p) {
+        return false;
+    }
+    conv.mStart = p++;
+    conv.mStars = 0;
+    conv.mArg = LOC_LOG_ARG_NONE;
+    if ('%' == *p) {
+        conv.mEnd = p + 1;
+        return true;
+    }
+
+    // flags, width and precision
+    while (*p && strchr("-+ #0'123456789.*", *p)) {
+        if ('*' == *p) {
+            conv.mStars++;
+        }
+        p++;
+    }
+    // length modifier
+    int length = 0;   // 1: l, 2: ll, 'z', 'j', 't', 'L'
+    if ('h' == *p) {
+        p += ('h' == p[1]) ? 2 : 1;
+    } else if ('l' == *p) {
+        length = ('l' == p[1]) ? 2 : 1;
+        p += length;
+    } else if ('q' == *p) {
+        length = 2;
+        p++;
+    } else if (*p && strchr("zjtL", *p)) {
+        length = *p++;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        switch (length) {
+        case 0:   conv.mArg = LOC_LOG_ARG_INT;     break;
+        case 1:   conv.mArg = LOC_LOG_ARG_LONG;    break;
+        case 'z': conv.mArg = LOC_LOG_ARG_SIZE;    break;
+        case 'j': conv.mArg = LOC_LOG_ARG_INTMAX;  break;
+        case 't': conv.mArg = LOC_LOG_ARG_PTRDIFF; break;
+        default:  conv.mArg = LOC_LOG_ARG_LLONG;   break;
+        }
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        conv.mArg = ('L' == length) ? LOC_LOG_ARG_LDOUBLE : LOC_LOG_ARG_DOUBLE;
+        break;
+    case 'p':
+        conv.mArg = LOC_LOG_ARG_PTR;
+        break;
+    case 's':
+        conv.mArg = LOC_LOG_ARG_STR;
+        break;
+    case 'n':
+        conv.mArg = LOC_LOG_ARG_COUNT;
+        break;
+    default:
+        // unknown conversion, printed as is
+        conv.mStars = 0;
+        break;
+    }
+    conv.mEnd = *p ? p + 1 : p;
+    return true;
+}
+
+// A record in the ring, followed by its arguments. Records are 8 byte
+// aligned; a record with no format pads the ring up to its end.
+struct LocLogRecord {
+    uint16_t mSize;
+    uint16_t mArgsLen;
+    uint8_t mPrio;
+    uint8_t mTruncated;
+    int32_t mTid;
+    uint64_t mTimeNs;
+    const char* mFormat;
+    const char* mTag;
+};
+
+#define LOC_LOG_RING_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+// The argument types of a format, '*' widths included, so each format is
+// parsed once per thread rather than on every record.
+struct LocLogFormat {
+    const char* mFormat;
+    uint8_t mNumArgs;
+    uint8_t mTruncated;
+    uint8_t mArgs[LOC_LOG_RING_MAX_CONVS];
+};
+
+// Single producer (the owner thread), single consumer (whoever holds
+// sRingsMutex) byte ring.
+struct LocLogRing {
+    LocLogRing* mNext;
+    uint8_t* mBuf;
+    uint32_t mSize;
+    int32_t mTid;
+    std::atomic<uint64_t> mHead;
+    std::atomic<uint64_t> mTail;
+    std::atomic<uint32_t> mDropped;
+    uint32_t mDroppedReported;
+    std::atomic<bool> mOrphaned;
+    // owner thread only
+    LocLogFormat mFormats[LOC_LOG_RING_FORMATS];
+
+    bool push(LocLogRecord& record, const uint8_t* args, size_t argsLen);
+    void drain();
+};
+
+static pthread_mutex_t sRingsMutex = PTHREAD_MUTEX_INITIALIZER;
+static LocLogRing* sRings = NULL;
+static pthread_key_t sRingKey;
+static pthread_once_t sRingKeyOnce = PTHREAD_ONCE_INIT;
+static __thread LocLogRing* tRing = NULL;
+static std::atomic<uint32_t> sRingSize(0);
+static std::atomic<bool> sFlusherStarted(false);
+// LocLogFlush waits on sFlusherCond while loc_logger.LOG_RING is 0
+static pthread_mutex_t sFlusherMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sFlusherCond = PTHREAD_COND_INITIALIZER;
+
+bool LocLogRing::push(LocLogRecord& record, const uint8_t* args, size_t argsLen) {
+    uint32_t size = LOC_LOG_RING_ALIGN(sizeof(LocLogRecord) + argsLen);
+    uint64_t head = mHead.load(std::memory_order_relaxed);
+    uint64_t tail = mTail.load(std::memory_order_acquire);
+    uint32_t offset = head & (mSize - 1);
+    uint32_t toEnd = mSize - offset;
+    uint32_t needed = (toEnd < size) ? toEnd + size : size;
+
+    if (mSize - (head - tail) < needed) {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (toEnd < size) {
+        if (toEnd >= sizeof(LocLogRecord)) {
+            LocLogRecord pad;
+            memset(&pad, 0, sizeof(pad));
+            memcpy(mBuf + offset, &pad, sizeof(pad));
+        }
+        head += toEnd;
+        offset = 0;
+    }
+    record.mSize = size;
+    memcpy(mBuf + offset, &record, sizeof(record));
+    memcpy(mBuf + offset + sizeof(record), args, argsLen);
+    mHead.store(head + size, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+static int locLogFormatArg(char* out, size_t len, const char* spec,
+                           int stars, const int* star, T value) {
+    switch (stars) {
+    case 0:  return snprintf(out, len, spec, value);
+    case 1:  return snprintf(out, len, spec, star[0], value);
+    default: return snprintf(out, len, spec, star[0], star[1], value);
+    }
+}
+
+// Formats a record the way printf would have when it was logged.
+static void locLogFormat(const LocLogRecord& record, const uint8_t* args,
+                         char* out, size_t len) {
+    const uint8_t* argsEnd = args + record.mArgsLen;
+    const char* fmt = record.mFormat;
+    char spec[32];
+    size_t used = 0;
+    LocLogConv conv;
+
+    while (used + 1 < len) {
+        bool more = locLogNextConv(fmt, conv);
+        const char* literalEnd = more ? conv.mStart : fmt + strlen(fmt);
+        size_t literal = literalEnd - fmt;
+        if (literal > len - used - 1) {
+            literal = len - used - 1;
+        }
+        memcpy(out + used, fmt, literal);
+        used += literal;
+        if (!more || used + 1 >= len) {
+            break;
+        }
+        fmt = conv.mEnd;
+
+        size_t specLen = conv.mEnd - conv.mStart;
+        if (LOC_LOG_ARG_NONE == conv.mArg) {
+            // "%%", or a conversion we do not know
+            const char* text = ('%' == conv.mStart[1]) ? "%" : conv.mStart;
+            size_t textLen = ('%' == conv.mStart[1]) ? 1 : specLen;
+            if (textLen > len - used - 1) {
+                textLen = len - used - 1;
+            }
+            memcpy(out + used, text, textLen);
+            used += textLen;
+            continue;
+        }
+
+        int star[2] = {0, 0};
+        int64_t value = 0;
+        double dvalue = 0;
+        char str[LOC_LOG_RING_MAX_STR + sizeof("...")];
+        bool missing = false;
+        for (int i = 0; i < conv.mStars && !missing; i++) {
+            missing = args + sizeof(int64_t) > argsEnd;
+            if (!missing) {
+                memcpy(&value, args, sizeof(value));
+                args += sizeof(value);
+                star[i < 2 ? i : 1] = (int)value;
+            }
+        }
+        if (!missing && LOC_LOG_ARG_STR == conv.mArg) {
+            uint16_t strLen = 0;
+            missing = args + sizeof(strLen) > argsEnd;
+            if (!missing) {
+                memcpy(&strLen, args, sizeof(strLen));
+                args += sizeof(strLen);
+                bool cut = false;
+                if (UINT16_MAX != strLen && (strLen & LOC_LOG_RING_STR_CUT)) {
+                    strLen &= ~LOC_LOG_RING_STR_CUT;
+                    cut = true;
+                }
+                if (UINT16_MAX == strLen) {
+                    strlcpy(str, "(null)", sizeof(str));
+                } else if (strLen > LOC_LOG_RING_MAX_STR || args + strLen > argsEnd) {
+                    missing = true;
+                } else {
+                    memcpy(str, args, strLen);
+                    strlcpy(str + strLen, cut ? "..." : "", sizeof(str) - strLen);
+                    args += strLen;
+                }
+            }
+        } else if (!missing && LOC_LOG_ARG_COUNT != conv.mArg) {
+            missing = args + sizeof(int64_t) > argsEnd;
+            if (!missing) {
+                memcpy(LOC_LOG_ARG_DOUBLE == conv.mArg || LOC_LOG_ARG_LDOUBLE == conv.mArg ?
+                       (void*)&dvalue : (void*)&value, args, sizeof(int64_t));
+                args += sizeof(int64_t);
+            }
+        }
+        if (missing || specLen >= sizeof(spec)) {
+            // arguments cut off when the record was written
+            strlcpy(out + used, "...", len - used);
+            used += strlen(out + used);
+            break;
+        }
+        memcpy(spec, conv.mStart, specLen);
+        spec[specLen] = '\0';
+
+        char* pos = out + used;
+        size_t room = len - used;
+        int n = 0;
+        switch (conv.mArg) {
+        case LOC_LOG_ARG_INT:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (int)value);
+            break;
+        case LOC_LOG_ARG_LONG:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (long)value);
+            break;
+        case LOC_LOG_ARG_LLONG:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (long long)value);
+            break;
+        case LOC_LOG_ARG_SIZE:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (size_t)value);
+            break;
+        case LOC_LOG_ARG_INTMAX:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (intmax_t)value);
+            break;
+        case LOC_LOG_ARG_PTRDIFF:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (ptrdiff_t)value);
+            break;
+        case LOC_LOG_ARG_DOUBLE:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, dvalue);
+            break;
+        case LOC_LOG_ARG_LDOUBLE:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (long double)dvalue);
+            break;
+        case LOC_LOG_ARG_PTR:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (void*)(intptr_t)value);
+            break;
+        case LOC_LOG_ARG_STR:
+            n = locLogFormatArg(pos, room, spec, conv.mStars, star, (const char*)str);
+            break;
+        default:
+            break;
+        }
+        if (n > 0) {
+            used += ((size_t)n < room) ? (size_t)n : room - 1;
+        }
+    }
+    if (record.mTruncated && used + 4 < len) {
+        strlcpy(out + used, "...", len - used);
+        used += 3;
+    }
+    out[used] = '\0';
+}
+
+void LocLogRing::drain() {
+    char line[LOC_LOG_RING_LINE];
+    uint64_t tail = mTail.load(std::memory_order_relaxed);
+    uint64_t head = mHead.load(std::memory_order_acquire);
+
+    while (tail < head) {
+        uint32_t offset = tail & (mSize - 1);
+        uint32_t toEnd = mSize - offset;
+        LocLogRecord record;
+
+        if (toEnd < sizeof(LocLogRecord)) {
+            tail += toEnd;
+            continue;
+        }
+        memcpy(&record, mBuf + offset, sizeof(record));
+        if (NULL == record.mFormat) {
+            tail += toEnd;
+            continue;
+        }
+        locLogFormat(record, mBuf + offset + sizeof(LocLogRecord), line, sizeof(line));
+        __android_log_print(record.mPrio, record.mTag, "[%llu.%06llu %d] %s",
+                            (unsigned long long)(record.mTimeNs / 1000000000),
+                            (unsigned long long)(record.mTimeNs % 1000000000 / 1000),
+                            record.mTid, line);
+        tail += record.mSize;
+        // hand the space back as we go, so the owner can keep logging
+        mTail.store(tail, std::memory_order_release);
+    }
+
+    uint32_t dropped = mDropped.load(std::memory_order_relaxed);
+    if (dropped != mDroppedReported) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                            "log ring of tid %d full, %u records dropped",
+                            mTid, dropped - mDroppedReported);
+        mDroppedReported = dropped;
+    }
+}
+
+static void locLogRingOrphan(void* ring) {
+    // the thread exited; the flusher frees the ring once it is drained
+    tRing = NULL;
+    ((LocLogRing*)ring)->mOrphaned.store(true, std::memory_order_release);
+}
+
+static void locLogRingKeyCreate() {
+    pthread_key_create(&sRingKey, locLogRingOrphan);
+}
+
+// the calling thread's ring, created on its first record
+static LocLogRing* locLogRingGet() {
+    if (NULL == tRing) {
+        uint32_t size = sRingSize.load(std::memory_order_relaxed);
+        LocLogRing* ring = new LocLogRing();
+        ring->mBuf = (uint8_t*)malloc(size);
+        if (NULL == ring->mBuf) {
+            delete ring;
+            return NULL;
+        }
+        ring->mSize = size;
+        ring->mTid = GETTID_PLATFORM_LIB_ABSTRACTION;
+        ring->mHead.store(0, std::memory_order_relaxed);
+        ring->mTail.store(0, std::memory_order_relaxed);
+        ring->mDropped.store(0, std::memory_order_relaxed);
+        ring->mDroppedReported = 0;
+        ring->mOrphaned.store(false, std::memory_order_relaxed);
+        memset(ring->mFormats, 0, sizeof(ring->mFormats));
+
+        pthread_once(&sRingKeyOnce, locLogRingKeyCreate);
+        pthread_setspecific(sRingKey, ring);
+        pthread_mutex_lock(&sRingsMutex);
+        ring->mNext = sRings;
+        sRings = ring;
+        pthread_mutex_unlock(&sRingsMutex);
+        tRing = ring;
+    }
+    return tRing;
+}
+
+// the argument types of fmt, parsed on the thread's first use of fmt
+static const LocLogFormat& locLogFormatOf(LocLogRing& ring, const char* fmt) {
+    LocLogFormat& format =
+        ring.mFormats[((uintptr_t)fmt / sizeof(void*)) % LOC_LOG_RING_FORMATS];
+    if (format.mFormat != fmt) {
+        LocLogConv conv;
+        format.mFormat = fmt;
+        format.mNumArgs = 0;
+        format.mTruncated = false;
+        for (const char* p = fmt; locLogNextConv(p, conv); p = conv.mEnd) {
+            int args = conv.mStars + (LOC_LOG_ARG_NONE != conv.mArg ? 1 : 0);
+            if (format.mNumArgs + args > LOC_LOG_RING_MAX_CONVS) {
+                format.mTruncated = true;
+                break;
+            }
+            for (int i = 0; i < conv.mStars; i++) {
+                format.mArgs[format.mNumArgs++] = LOC_LOG_ARG_INT;
+            }
+            if (LOC_LOG_ARG_NONE != conv.mArg) {
+                format.mArgs[format.mNumArgs++] = conv.mArg;
+            }
+        }
+    }
+    return format;
+}
+
+// Copies an argument into the record; false if the record is full.
+static inline bool locLogPut(uint8_t* args, size_t& len, const void* value, size_t size) {
+    if (len + size > LOC_LOG_RING_MAX_ARGS) {
+        return false;
+    }
+    memcpy(args + len, value, size);
+    len += size;
+    return true;
+}
+
+// records a log message in ring, see loc_log_ring_write()
+static void locLogRingVWrite(LocLogRing* ring, int prio, const char* tag,
+                             const char* fmt, va_list ap)
+{
+    LocLogRecord record;
+    uint8_t args[LOC_LOG_RING_MAX_ARGS];
+    size_t len = 0;
+    bool full = false;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record.mPrio = prio;
+    record.mTid = ring->mTid;
+    record.mTimeNs = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    record.mFormat = fmt;
+    record.mTag = tag;
+
+    const LocLogFormat& format = locLogFormatOf(*ring, fmt);
+    for (uint32_t i = 0; i < format.mNumArgs && !full; i++) {
+        int64_t value = 0;
+        double dvalue = 0;
+        switch (format.mArgs[i]) {
+        case LOC_LOG_ARG_INT:     value = va_arg(ap, int);                    break;
+        case LOC_LOG_ARG_LONG:    value = va_arg(ap, long);                   break;
+        case LOC_LOG_ARG_LLONG:   value = va_arg(ap, long long);              break;
+        case LOC_LOG_ARG_SIZE:    value = va_arg(ap, size_t);                 break;
+        case LOC_LOG_ARG_INTMAX:  value = va_arg(ap, intmax_t);               break;
+        case LOC_LOG_ARG_PTRDIFF: value = va_arg(ap, ptrdiff_t);              break;
+        case LOC_LOG_ARG_DOUBLE:  dvalue = va_arg(ap, double);                break;
+        case LOC_LOG_ARG_LDOUBLE: dvalue = (double)va_arg(ap, long double);   break;
+        case LOC_LOG_ARG_PTR:     value = (intptr_t)va_arg(ap, void*);        break;
+        case LOC_LOG_ARG_COUNT:   (void)va_arg(ap, void*);                    continue;
+        case LOC_LOG_ARG_STR: {
+            const char* str = va_arg(ap, const char*);
+            uint16_t strLen = UINT16_MAX;
+            uint16_t recorded = UINT16_MAX;
+            if (NULL != str) {
+                strLen = strnlen(str, LOC_LOG_RING_MAX_STR);
+                recorded = strLen;
+                if (LOC_LOG_RING_MAX_STR == strLen && '\0' != str[strLen]) {
+                    recorded |= LOC_LOG_RING_STR_CUT;
+                }
+                if (len + sizeof(strLen) + strLen > LOC_LOG_RING_MAX_ARGS &&
+                    len + sizeof(strLen) < LOC_LOG_RING_MAX_ARGS) {
+                    // keep what fits of the last string
+                    strLen = LOC_LOG_RING_MAX_ARGS - len - sizeof(strLen);
+                    recorded = strLen;
+                    full = true;
+                }
+            }
+            if (!locLogPut(args, len, &recorded, sizeof(recorded)) ||
+                (UINT16_MAX != strLen && !locLogPut(args, len, str, strLen))) {
+                full = true;
+            }
+            continue;
+        }
+        default:
+            continue;
+        }
+        if (LOC_LOG_ARG_DOUBLE == format.mArgs[i] || LOC_LOG_ARG_LDOUBLE == format.mArgs[i]) {
+            full = !locLogPut(args, len, &dvalue, sizeof(dvalue));
+        } else {
+            full = !locLogPut(args, len, &value, sizeof(value));
+        }
+    }
+    record.mTruncated = full || format.mTruncated;
+    record.mArgsLen = len;
+
+    ring->push(record, args, len);
+}
+
+/*===========================================================================
+FUNCTION loc_log_ring_write
+
+DESCRIPTION
+   Records a log message in the calling thread's log ring, to be formatted
+   when the ring is flushed. fmt must be a string literal.
+
+DEPENDENCIES
+   loc_log_ring_init() enabled the rings
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_log_ring_write(int prio, const char* tag, const char* fmt, ...)
+{
+    va_list ap;
+    LocLogRing* ring = locLogRingGet();
+    va_start(ap, fmt);
+    if (NULL == ring) {
+        __android_log_vprint(prio, tag, fmt, ap);
+    } else {
+        locLogRingVWrite(ring, prio, tag, fmt, ap);
+    }
+    va_end(ap);
+}
+
+/*===========================================================================
+FUNCTION loc_log_out
+
+DESCRIPTION
+   Logs a message of the LOC_LOGx macros: recorded in the calling thread's
+   log ring if the rings are on and fmt is a literal, which the macros
+   tell with fmt_is_literal, and handed to the Android logger otherwise.
+   Out of line, so each call site expands its arguments once.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_log_out(int prio, const char* tag, int fmt_is_literal, const char* fmt, ...)
+{
+    va_list ap;
+    LocLogRing* ring = (fmt_is_literal && loc_logger.LOG_RING) ? locLogRingGet() : NULL;
+    va_start(ap, fmt);
+    if (NULL == ring) {
+        __android_log_vprint(prio, tag, fmt, ap);
+    } else {
+        locLogRingVWrite(ring, prio, tag, fmt, ap);
+    }
+    va_end(ap);
+}
+
+/*===========================================================================
+FUNCTION loc_log_ring_flush
+
+DESCRIPTION
+   Formats the records of every thread's log ring and hands them to the
+   Android logger, oldest first within each thread. Frees the rings of
+   threads that have exited.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_log_ring_flush(void)
+{
+    pthread_mutex_lock(&sRingsMutex);
+    for (LocLogRing** ring = &sRings; NULL != *ring; ) {
+        bool orphaned = (*ring)->mOrphaned.load(std::memory_order_acquire);
+        (*ring)->drain();
+        if (orphaned) {
+            LocLogRing* freed = *ring;
+            *ring = freed->mNext;
+            free(freed->mBuf);
+            delete freed;
+        } else {
+            ring = &(*ring)->mNext;
+        }
+    }
+    pthread_mutex_unlock(&sRingsMutex);
+}
+
+class LocLogFlusher : public LocRunnable {
+public:
+    virtual bool run() {
+        // parked while the rings are off
+        pthread_mutex_lock(&sFlusherMutex);
+        while (0 == loc_logger.LOG_RING) {
+            pthread_cond_wait(&sFlusherCond, &sFlusherMutex);
+        }
+        pthread_mutex_unlock(&sFlusherMutex);
+        usleep(LOC_LOG_RING_FLUSH_MS * 1000);
+        loc_log_ring_flush();
+        return true;
+    }
+};
+
+/*===========================================================================
+FUNCTION loc_log_ring_init
+
+DESCRIPTION
+   Switches the LOC_LOGx macros to the per-thread binary log rings, with
+   ring_kb KB per thread, or back to logging at once if ring_kb is 0,
+   which parks the LocLogFlush thread. A new size applies to the threads
+   that log for the first time after.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_log_ring_init(unsigned long ring_kb)
+{
+    if (0 == ring_kb) {
+        if (loc_logger.LOG_RING) {
+            pthread_mutex_lock(&sFlusherMutex);
+            loc_logger.LOG_RING = 0;
+            pthread_mutex_unlock(&sFlusherMutex);
+            loc_log_ring_flush();
+        }
+        return;
+    }
+
+    if (ring_kb < LOC_LOG_RING_MIN_KB) {
+        ring_kb = LOC_LOG_RING_MIN_KB;
+    } else if (ring_kb > LOC_LOG_RING_MAX_KB) {
+        ring_kb = LOC_LOG_RING_MAX_KB;
+    }
+    uint32_t size = LOC_LOG_RING_MIN_KB * 1024;
+    while (size < ring_kb * 1024) {
+        size <<= 1;
+    }
+    sRingSize.store(size, std::memory_order_relaxed);
+
+    // set first: starting the flusher may parse gps.conf, which can come
+    // back here. It waits for LOG_RING to be set below.
+    if (!sFlusherStarted.exchange(true)) {
+        LocThread* flusher = new LocThread();
+        if (!flusher->start("LocLogFlush", new LocLogFlusher(), false)) {
+            LOC_LOGE("%s: failed to start the log flusher, logging at once", __FUNCTION__);
+            delete flusher;
+            sFlusherStarted.store(false);
+            return;
+        }
+    }
+    pthread_mutex_lock(&sFlusherMutex);
+    loc_logger.LOG_RING = ring_kb;
+    pthread_cond_signal(&sFlusherCond);
+    pthread_mutex_unlock(&sFlusherMutex);
+}
+
+#ifdef __LOC_DEBUG__
+
+// formats the newest record of the calling thread's ring, and drops it
+static void locLogRingTestTake(char* out, size_t len) {
+    LocLogRing* ring = tRing;
+    uint64_t tail = ring->mTail.load();
+    uint64_t head = ring->mHead.load();
+    LocLogRecord record;
+    while (tail < head) {
+        uint32_t offset = tail & (ring->mSize - 1);
+        if (ring->mSize - offset < sizeof(LocLogRecord)) {
+            tail += ring->mSize - offset;
+            continue;
+        }
+        memcpy(&record, ring->mBuf + offset, sizeof(record));
+        if (NULL == record.mFormat) {
+            tail += ring->mSize - offset;
+            continue;
+        }
+        locLogFormat(record, ring->mBuf + offset + sizeof(LocLogRecord), out, len);
+        tail += record.mSize;
+    }
+    ring->mTail.store(tail);
+}
+
+#define LOC_LOG_RING_TEST(...)                                         \
+    do {                                                               \
+        char expected[LOC_LOG_RING_LINE], got[LOC_LOG_RING_LINE];      \
+        snprintf(expected, sizeof(expected), __VA_ARGS__);             \
+        loc_log_ring_write(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__);   \
+        locLogRingTestTake(got, sizeof(got));                          \
+        if (strcmp(expected, got) != 0) {                              \
+            printf("mismatch:\n  %s\n  %s\n", expected, got);          \
+            mismatches++;                                              \
+        }                                                              \
+    } while (0)
+
+static int gMessages;
+static std::atomic<uint64_t> gCpuNs;
+
+// what LocApiBase::reportSv logs for each SV; counts the cpu time the
+// logging thread spends
+static void* locLogRingTestLog(void*) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for (int i = 0; i < gMessages; i++) {
+        LOC_LOGV("%s:%d] sv %d: prn %d snr %.2f elev %.1f azim %.1f used %s",
+                 __func__, __LINE__, i % 64, i % 32 + 1, 35.5, 42.25, 187.5,
+                 (i & 1) ? "true" : "false");
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    gCpuNs += (end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec;
+    return NULL;
+}
+
+// cpu ns per message of the logging threads
+static double locLogRingTestRun(int threads) {
+    pthread_t tids[threads];
+    gCpuNs = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, locLogRingTestLog, NULL);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return gCpuNs / ((double)threads * gMessages);
+}
+
+// For Linux command line testing, with the messages going to stderr:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -O2 -I. -I../../../../system/core/include loc_log_ring.cpp loc_cfg.cpp loc_log.cpp loc_misc_utils.cpp LocThread.cpp -lpthread
+// test: ./a.out 4 5000 2>/dev/null
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    gMessages = argc > 2 ? atoi(argv[2]) : 5000;
+    int mismatches = 0;
+
+    loc_log_ring_init(64);
+    loc_logger_init(5, 0);
+
+    const char* str = "reportSv";
+    LOC_LOG_RING_TEST("%s:%d] plain", str, 42);
+    LOC_LOG_RING_TEST("%5.2f|%-8s|%*d|%.*s|%e|%g", 3.14159, "ab", 6, -12, 3, "abcdef", 1e-7, 0.5);
+    LOC_LOG_RING_TEST("%lld %llu %zu %ld %lx %hhd %hu %c %%", -5LL, 7ULL, (size_t)9,
+                      -123456789L, 0xdeadbeefL, 300, 70000, 'x');
+    LOC_LOG_RING_TEST("%p %s %08X", (void*)0x1234, (const char*)NULL, 0xbeef);
+    LOC_LOG_RING_TEST("%s", "a string of exactly the ninety six bytes kept of each "
+                      "string argument, which is kept whole here.");
+
+    // a longer string is cut short, and shows it
+    const char* longStr = "a string longer than the ninety six bytes kept of each string"
+        " argument of a record, so it is cut short when it is recorded";
+    char expected[LOC_LOG_RING_LINE], got[LOC_LOG_RING_LINE];
+    snprintf(expected, sizeof(expected), "[%.*s...]", LOC_LOG_RING_MAX_STR, longStr);
+    loc_log_ring_write(ANDROID_LOG_DEBUG, LOG_TAG, "[%s]", longStr);
+    locLogRingTestTake(got, sizeof(got));
+    if (strcmp(expected, got) != 0) {
+        printf("mismatch:\n  %s\n  %s\n", expected, got);
+        mismatches++;
+    }
+    printf("format mismatches %d\n", mismatches);
+
+    // turned off, the flusher parks, and picks up again when turned on
+    loc_log_ring_init(0);
+    LOC_LOGD("logged at once while the rings are off");
+    loc_log_ring_init(64);
+
+    loc_logger.LOG_RING = 0;
+    double directNs = locLogRingTestRun(threads);
+    loc_log_ring_init(1024);
+    double ringNs = locLogRingTestRun(threads);
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    loc_log_ring_flush();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    double flushNs = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+        ((double)threads * gMessages);
+
+    printf("LOC_LOGV, %d threads: formatted at once %.0f ns, ring %.0f ns "
+           "(+ %.0f ns in the flusher)\n", threads, directNs, ringNs, flushNs);
+    return 0;
+}
+
+#endif
@@ -62,7 +62,18 @@ void* loc_timer_start(uint64_t delay_msec,
                       bool wake_on_expire=false);
 
 /*
-    handle becomes invalid upon the return of the callback
+    Same as loc_timer_start(), except that cb_func is called every
+    period_msec, each period counted from the previous deadline, until
+    loc_timer_stop() is called with the returned handle.
+*/
+void* loc_timer_start_periodic(uint64_t period_msec,
+                               loc_timer_callback cb_func,
+                               void *user_data,
+                               bool wake_on_expire=false);
+
+/*
+    handle becomes invalid upon the return of the callback, or for a
+    periodic timer, upon the return of this call
 */
 void loc_timer_stop(void*& handle);
 
@@ -45,6 +45,10 @@
 
 #endif  // LOG_TAG
 
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG 0
+#endif  // LOG_NDEBUG
+
 #endif /* USE_GLIB */
 
 #ifdef __cplusplus
@@ -61,8 +65,22 @@ typedef struct loc_logger_s
 {
   unsigned long  DEBUG_LEVEL;
   unsigned long  TIMESTAMP;
+  unsigned long  LOG_RING;     /* KB of binary log ring per thread, 0 for off */
 } loc_logger_s_type;
 
+/* Per call site cache of the level of its LOG_TAG. The level is looked up
+   on first use and kept up to date by loc_logger_init() and
+   loc_log_set_tag_levels(), so checking it costs a load and a branch */
+typedef struct loc_log_site_s
+{
+  unsigned char           level;       /* LOC_LOG_SITE_UNRESOLVED until used */
+  unsigned char           registered;
+  const char*             tag;
+  struct loc_log_site_s*  next;
+} loc_log_site_s_type;
+
+#define LOC_LOG_SITE_UNRESOLVED 0xff
+
 /*=============================================================================
  *
  *                               EXTERNAL DATA
@@ -90,6 +108,14 @@ extern const char EXIT_ERROR_TAG[];
  *============================================================================*/
 extern void loc_logger_init(unsigned long debug, unsigned long timestamp);
 extern char* get_timestamp(char* str, unsigned long buf_size);
+extern int loc_log_site_resolve(loc_log_site_s_type* site);
+extern void loc_log_set_tag_levels(const char* tag_levels);
+extern void loc_log_ring_init(unsigned long ring_kb);
+extern void loc_log_ring_write(int prio, const char* tag, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+extern void loc_log_ring_flush(void);
+extern void loc_log_out(int prio, const char* tag, int fmt_is_literal, const char* fmt, ...)
+    __attribute__((format(printf, 4, 5)));
 
 #ifndef DEBUG_DMN_LOC_API
 
@@ -97,18 +123,38 @@ extern char* get_timestamp(char* str, unsigned long buf_size);
 /*loc_logger.DEBUG_LEVEL is initialized to 0xff in loc_cfg.cpp
   if that value remains unchanged, it means gps.conf did not
   provide a value and we default to the initial value to use
-  Android's logging levels*/
-#define IF_LOC_LOGE if((loc_logger.DEBUG_LEVEL >= 1) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGW if((loc_logger.DEBUG_LEVEL >= 2) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGI if((loc_logger.DEBUG_LEVEL >= 3) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGD if((loc_logger.DEBUG_LEVEL >= 4) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGV if((loc_logger.DEBUG_LEVEL >= 5) && (loc_logger.DEBUG_LEVEL <= 5))
-
-#define LOC_LOGE(...) IF_LOC_LOGE { ALOGE(__VA_ARGS__); }
-#define LOC_LOGW(...) IF_LOC_LOGW { ALOGW(__VA_ARGS__); }
-#define LOC_LOGI(...) IF_LOC_LOGI { ALOGI(__VA_ARGS__); }
-#define LOC_LOGD(...) IF_LOC_LOGD { ALOGD(__VA_ARGS__); }
-#define LOC_LOGV(...) IF_LOC_LOGV { ALOGV(__VA_ARGS__); }
+  Android's logging levels. LOG_TAG_LEVELS in gps.conf overrides
+  DEBUG_LEVEL for the tags it names. Each call site caches the
+  level of its LOG_TAG, resolving it the first time it runs*/
+#define LOC_LOG_ON_(LEVEL) ({                                                 \
+    static loc_log_site_s_type loc_log_site_ =                                \
+        { LOC_LOG_SITE_UNRESOLVED, 0, LOG_TAG, NULL };                        \
+    unsigned char loc_log_level_ =                                            \
+        __atomic_load_n(&loc_log_site_.level, __ATOMIC_RELAXED);              \
+    __builtin_expect(loc_log_level_ >= (LEVEL), 0) &&                         \
+        (loc_log_level_ != LOC_LOG_SITE_UNRESOLVED ||                         \
+         loc_log_site_resolve(&loc_log_site_) >= (LEVEL)); })
+
+#define IF_LOC_LOGE if(LOC_LOG_ON_(1))
+#define IF_LOC_LOGW if(LOC_LOG_ON_(2))
+#define IF_LOC_LOGI if(LOC_LOG_ON_(3))
+#define IF_LOC_LOGD if(LOC_LOG_ON_(4))
+#define IF_LOC_LOGV if(LOC_LOG_ON_(5))
+
+/* With the binary log rings on, a message whose format is a literal is
+   recorded and formatted later, by the log flusher */
+#define LOC_LOG_FORMAT_(FMT, ...) FMT
+#define LOC_LOG_OUT_(PRIO, ...)                                               \
+    loc_log_out(PRIO, LOG_TAG,                                                \
+                __builtin_constant_p(LOC_LOG_FORMAT_(__VA_ARGS__, 0)),        \
+                __VA_ARGS__)
+
+#define LOC_LOGE(...) IF_LOC_LOGE { LOC_LOG_OUT_(ANDROID_LOG_ERROR, __VA_ARGS__); }
+#define LOC_LOGW(...) IF_LOC_LOGW { LOC_LOG_OUT_(ANDROID_LOG_WARN, __VA_ARGS__); }
+#define LOC_LOGI(...) IF_LOC_LOGI { LOC_LOG_OUT_(ANDROID_LOG_INFO, __VA_ARGS__); }
+#define LOC_LOGD(...) IF_LOC_LOGD { LOC_LOG_OUT_(ANDROID_LOG_DEBUG, __VA_ARGS__); }
+/* compiled out with LOG_NDEBUG set, the same as ALOGV */
+#define LOC_LOGV(...) IF_LOC_LOGV { if (!LOG_NDEBUG) { LOC_LOG_OUT_(ANDROID_LOG_VERBOSE, __VA_ARGS__); } }
 
 #else /* DEBUG_DMN_LOC_API */
 
@@ -127,7 +173,7 @@ extern char* get_timestamp(char* str, unsigned long buf_size);
  *============================================================================*/
 #define LOG_(LOC_LOG, ID, WHAT, SPEC, VAL)                                    \
     do {                                                                      \
-        if (loc_logger.TIMESTAMP) {                                           \
+        if (loc_logger.TIMESTAMP && !loc_logger.LOG_RING) {                   \
             char ts[32];                                                      \
             LOC_LOG("[%s] %s %s line %d " #SPEC,                              \
                      get_timestamp(ts, sizeof(ts)), ID, WHAT, __LINE__, VAL); \
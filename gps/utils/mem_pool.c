@@ -0,0 +1,278 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mem_pool.h"
+
+#define LOG_TAG "LocSvc_utils_pool"
+#include "log_util.h"
+#include "platform_lib_includes.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Elements are aligned to what malloc aligns to */
+#define MEM_POOL_ALIGN (2 * sizeof(void*))
+
+typedef struct free_elem {
+   struct free_elem* next;
+} free_elem;
+
+typedef struct mem_pool {
+   char* block;                     /* Memory of all the elements; NULL until first alloc */
+   free_elem* free_list;            /* Elements not in use */
+   pthread_mutex_t mutex;           /* Mutex for exclusive access to the pool */
+   mem_pool_stats_type stats;       /* Statistics of the pool */
+} mem_pool;
+
+/* ----------------------- INTERNAL FUNCTIONS ---------------------------------------- */
+
+/*===========================================================================
+FUNCTION    mem_pool_fill
+
+DESCRIPTION
+   Called with mutex held upon first allocation, to take the memory of all
+   the elements from the heap and chain them up in the free list.
+
+   p_pool: pool to fill.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None; free_list stays NULL if the memory can not be allocated.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void mem_pool_fill(mem_pool* p_pool)
+{
+   uint32_t i;
+   p_pool->block = (char*)malloc((size_t)p_pool->stats.elem_size * p_pool->stats.capacity);
+   if( p_pool->block == NULL )
+   {
+      LOC_LOGE("%s: Unable to allocate %u elements of %u bytes!\n", __FUNCTION__,
+               p_pool->stats.capacity, p_pool->stats.elem_size);
+      /* don't try again, fall back to the heap for good */
+      p_pool->stats.capacity = 0;
+      return;
+   }
+
+   for( i = p_pool->stats.capacity; i > 0; i-- )
+   {
+      free_elem* elem = (free_elem*)(p_pool->block + (size_t)(i - 1) * p_pool->stats.elem_size);
+      elem->next = p_pool->free_list;
+      p_pool->free_list = elem;
+   }
+}
+
+/* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
+
+/*===========================================================================
+
+  FUNCTION:   mem_pool_init
+
+  ===========================================================================*/
+mem_pool_err_type mem_pool_init(void** mem_pool_data, size_t elem_size, uint32_t capacity)
+{
+   if( mem_pool_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid mem_pool_data parameter!\n", __FUNCTION__);
+      return eMEM_POOL_INVALID_PARAMETER;
+   }
+
+   *mem_pool_data = NULL;
+
+   if( elem_size == 0 || elem_size > UINT32_MAX - MEM_POOL_ALIGN )
+   {
+      LOC_LOGE("%s: Invalid elem_size parameter!\n", __FUNCTION__);
+      return eMEM_POOL_INVALID_PARAMETER;
+   }
+
+   mem_pool* p_pool = (mem_pool*)calloc(1, sizeof(mem_pool));
+   if( p_pool == NULL )
+   {
+      LOC_LOGE("%s: Unable to allocate space for memory pool!\n", __FUNCTION__);
+      return eMEM_POOL_FAILURE_GENERAL;
+   }
+
+   if( pthread_mutex_init(&p_pool->mutex, NULL) != 0 )
+   {
+      LOC_LOGE("%s: Unable to initialize pool mutex!\n", __FUNCTION__);
+      free(p_pool);
+      return eMEM_POOL_FAILURE_GENERAL;
+   }
+
+   p_pool->stats.elem_size = (uint32_t)((elem_size + MEM_POOL_ALIGN - 1) & ~(MEM_POOL_ALIGN - 1));
+   p_pool->stats.capacity = capacity;
+
+   *mem_pool_data = p_pool;
+
+   return eMEM_POOL_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   mem_pool_destroy
+
+  ===========================================================================*/
+mem_pool_err_type mem_pool_destroy(void** mem_pool_data)
+{
+   if( mem_pool_data == NULL || *mem_pool_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid mem_pool_data parameter!\n", __FUNCTION__);
+      return eMEM_POOL_INVALID_HANDLE;
+   }
+
+   mem_pool* p_pool = (mem_pool*)*mem_pool_data;
+
+   if( p_pool->stats.in_use != 0 )
+   {
+      LOC_LOGW("%s: %u elements still in use!\n", __FUNCTION__, p_pool->stats.in_use);
+   }
+
+   pthread_mutex_destroy(&p_pool->mutex);
+   free(p_pool->block);
+   free(p_pool);
+   *mem_pool_data = NULL;
+
+   return eMEM_POOL_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   mem_pool_alloc
+
+  ===========================================================================*/
+void* mem_pool_alloc(void* mem_pool_data)
+{
+   void* ptr = NULL;
+   if( mem_pool_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid mem_pool_data parameter!\n", __FUNCTION__);
+      return NULL;
+   }
+
+   mem_pool* p_pool = (mem_pool*)mem_pool_data;
+
+   pthread_mutex_lock(&p_pool->mutex);
+
+   if( p_pool->block == NULL && p_pool->stats.capacity != 0 )
+   {
+      mem_pool_fill(p_pool);
+   }
+
+   if( p_pool->free_list != NULL )
+   {
+      ptr = p_pool->free_list;
+      p_pool->free_list = p_pool->free_list->next;
+      p_pool->stats.hits++;
+      p_pool->stats.in_use++;
+      if( p_pool->stats.in_use > p_pool->stats.max_in_use )
+      {
+         p_pool->stats.max_in_use = p_pool->stats.in_use;
+      }
+   }
+   else
+   {
+      p_pool->stats.misses++;
+   }
+
+   pthread_mutex_unlock(&p_pool->mutex);
+
+   if( ptr == NULL )
+   {
+      ptr = malloc(p_pool->stats.elem_size);
+   }
+
+   return ptr;
+}
+
+/*===========================================================================
+
+  FUNCTION:   mem_pool_free
+
+  ===========================================================================*/
+void mem_pool_free(void* mem_pool_data, void* ptr)
+{
+   if( mem_pool_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid mem_pool_data parameter!\n", __FUNCTION__);
+      return;
+   }
+
+   if( ptr == NULL )
+   {
+      return;
+   }
+
+   mem_pool* p_pool = (mem_pool*)mem_pool_data;
+   char* p = (char*)ptr;
+
+   /* block and capacity never change once the block is taken */
+   if( p_pool->block == NULL || p < p_pool->block ||
+       p >= p_pool->block + (size_t)p_pool->stats.elem_size * p_pool->stats.capacity )
+   {
+      free(ptr);
+      return;
+   }
+
+   pthread_mutex_lock(&p_pool->mutex);
+   free_elem* elem = (free_elem*)ptr;
+   elem->next = p_pool->free_list;
+   p_pool->free_list = elem;
+   p_pool->stats.in_use--;
+   pthread_mutex_unlock(&p_pool->mutex);
+}
+
+/*===========================================================================
+
+  FUNCTION:   mem_pool_get_stats
+
+  ===========================================================================*/
+mem_pool_err_type mem_pool_get_stats(void* mem_pool_data, mem_pool_stats_type* stats)
+{
+   if( mem_pool_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid mem_pool_data parameter!\n", __FUNCTION__);
+      return eMEM_POOL_INVALID_HANDLE;
+   }
+
+   if( stats == NULL )
+   {
+      LOC_LOGE("%s: Invalid stats parameter!\n", __FUNCTION__);
+      return eMEM_POOL_INVALID_PARAMETER;
+   }
+
+   mem_pool* p_pool = (mem_pool*)mem_pool_data;
+
+   pthread_mutex_lock(&p_pool->mutex);
+   *stats = p_pool->stats;
+   pthread_mutex_unlock(&p_pool->mutex);
+
+   return eMEM_POOL_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MEM_POOL_H__
+#define __MEM_POOL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/** Memory Pool Return Codes */
+typedef enum
+{
+  eMEM_POOL_SUCCESS                          = 0,
+     /**< Request was successful. */
+  eMEM_POOL_FAILURE_GENERAL                  = -1,
+     /**< Failed because of a general failure. */
+  eMEM_POOL_INVALID_PARAMETER                = -2,
+     /**< Failed because the request contained invalid parameters. */
+  eMEM_POOL_INVALID_HANDLE                   = -3,
+     /**< Failed because an invalid handle was specified. */
+}mem_pool_err_type;
+
+/** Memory Pool Statistics */
+typedef struct
+{
+  uint32_t elem_size;
+     /**< Size of each element, rounded up for alignment. */
+  uint32_t capacity;
+     /**< Number of elements the pool holds. */
+  uint32_t in_use;
+     /**< Number of pool elements currently allocated. */
+  uint32_t max_in_use;
+     /**< Largest number of pool elements that has been allocated. */
+  uint64_t hits;
+     /**< Number of allocations served from the pool. */
+  uint64_t misses;
+     /**< Number of allocations that fell back to malloc, the pool being
+          used up. */
+}mem_pool_stats_type;
+
+/*===========================================================================
+FUNCTION    mem_pool_init
+
+DESCRIPTION
+   Initializes a pool of fixed size elements. Memory for all of the elements
+   is taken in one block with the first allocation, and is not returned to
+   the heap until the pool is destroyed. The pool is thread safe.
+
+   mem_pool_data: pointer to an opaque pool handle to be returned; NULL if
+                  fails
+   elem_size:     size of each element.
+   capacity:      number of elements in the pool.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+mem_pool_err_type mem_pool_init(void** mem_pool_data, size_t elem_size, uint32_t capacity);
+
+/*===========================================================================
+FUNCTION    mem_pool_destroy
+
+DESCRIPTION
+   Releases the pool. All the elements allocated from the pool must have
+   been freed back to it.
+
+   mem_pool_data: pointer to the pool handle; NULL upon return.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+mem_pool_err_type mem_pool_destroy(void** mem_pool_data);
+
+/*===========================================================================
+FUNCTION    mem_pool_alloc
+
+DESCRIPTION
+   Allocates an element from the pool; or from the heap if all elements of
+   the pool are in use.
+
+   mem_pool_data: pool to allocate from.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   pointer to memory of at least elem_size bytes; NULL if fails.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void* mem_pool_alloc(void* mem_pool_data);
+
+/*===========================================================================
+FUNCTION    mem_pool_free
+
+DESCRIPTION
+   Frees an element allocated by mem_pool_alloc, back to the pool or to the
+   heap, wherever it came from.
+
+   mem_pool_data: pool the element was allocated from.
+   ptr:           element to free; NULL is ignored.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void mem_pool_free(void* mem_pool_data, void* ptr);
+
+/*===========================================================================
+FUNCTION    mem_pool_get_stats
+
+DESCRIPTION
+   Takes a snapshot of the pool statistics.
+
+   mem_pool_data: pool to get statistics of.
+   stats:         Pointer to space to copy statistics to.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+mem_pool_err_type mem_pool_get_stats(void* mem_pool_data, mem_pool_stats_type* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __MEM_POOL_H__ */
@@ -36,11 +36,26 @@
 #include <stdlib.h>
 #include <pthread.h>
 
+/* Smallest high water mark msg_q_snd reports; capacity is always reported */
+#define MSG_Q_HIGH_WATER_REPORT_MIN 8
+
+/* Default max number of high priority messages received in a row while
+   normal priority ones are waiting */
+#define MSG_Q_HIGH_BURST_DEFAULT 8
+
 typedef struct msg_q {
    void* msg_list;                  /* Linked list to store information */
+   void* high_list;                 /* Linked list of high priority messages */
+   uint32_t high_burst;             /* Max high priority messages in a row, 0 for no max */
+   uint32_t high_run;               /* High priority messages in a row so far */
    pthread_cond_t  list_cond;       /* Condition variable for waiting on msg queue */
+   pthread_cond_t  space_cond;      /* Condition variable for waiting on room in a full queue */
    pthread_mutex_t list_mutex;      /* Mutex for exclusive access to message queue */
    int unblocked;                   /* Has this message queue been unblocked? */
+   msg_q_full_policy_type policy;   /* What to do when a bounded queue is full */
+   pthread_t reader;                /* Last thread that received from the queue */
+   int has_reader;                  /* Is reader valid? */
+   msg_q_stats_type stats;          /* Statistics of the message queue */
 } msg_q;
 
 /*===========================================================================
@@ -82,6 +97,262 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
    }
 }
 
+/*===========================================================================
+FUNCTION    msg_q_make_room
+
+DESCRIPTION
+   Called with list_mutex held when a bounded queue is full. Makes room for
+   one more message per the queue policy, by dropping an older message or
+   by waiting for the reader to take some out.
+
+   p_msg_q: Message queue that is full.
+   lane:    List the message is to be sent to.
+   key:     Key of the message to be sent.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   eMSG_Q_SUCCESS, eMSG_Q_DROPPED_OLDEST or eMSG_Q_COALESCED if the message
+   can be added; eMSG_Q_UNAVAILABLE_RESOURCE if the queue got unblocked.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_q_make_room(msg_q* p_msg_q, void* lane, uint32_t key)
+{
+   if( p_msg_q->policy == eMSG_Q_FULL_COALESCE && key != LINKED_LIST_NO_KEY &&
+       linked_list_remove_keyed(lane, key, NULL) == eLINKED_LIST_SUCCESS )
+   {
+      p_msg_q->stats.size--;
+      p_msg_q->stats.coalesced++;
+      return eMSG_Q_COALESCED;
+   }
+
+   /* high priority messages, and those sent without a key, are never
+      dropped; with none to drop, the sender waits as eMSG_Q_FULL_BLOCK */
+   if( p_msg_q->policy == eMSG_Q_FULL_DROP_OLDEST &&
+       linked_list_remove_keyed(p_msg_q->msg_list, LINKED_LIST_ANY_KEY, NULL) ==
+       eLINKED_LIST_SUCCESS )
+   {
+      p_msg_q->stats.size--;
+      p_msg_q->stats.dropped++;
+      return eMSG_Q_DROPPED_OLDEST;
+   }
+
+   /* The reader would never wake up to make room for itself */
+   if( p_msg_q->has_reader && pthread_equal(p_msg_q->reader, pthread_self()) )
+   {
+      return eMSG_Q_SUCCESS;
+   }
+
+   p_msg_q->stats.blocked++;
+   while( p_msg_q->stats.size >= p_msg_q->stats.capacity && !p_msg_q->unblocked )
+   {
+      pthread_cond_wait(&p_msg_q->space_cond, &p_msg_q->list_mutex);
+   }
+
+   return p_msg_q->unblocked ? eMSG_Q_UNAVAILABLE_RESOURCE : eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_room_made
+
+DESCRIPTION
+   Called with list_mutex held after messages are taken out of the queue,
+   to wake up senders waiting on a full queue.
+
+   p_msg_q: Message queue messages were taken out of.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_q_room_made(msg_q* p_msg_q)
+{
+   if( p_msg_q->stats.capacity != 0 && p_msg_q->stats.blocked != 0 )
+   {
+      pthread_cond_broadcast(&p_msg_q->space_cond);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_is_empty
+
+DESCRIPTION
+   Called with list_mutex held, to tell if there is any message in any
+   of the lanes.
+
+   p_msg_q: Message queue to check.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if there is no message; 0 otherwise.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_q_is_empty(msg_q* p_msg_q)
+{
+   return linked_list_empty(p_msg_q->high_list) && linked_list_empty(p_msg_q->msg_list);
+}
+
+/*===========================================================================
+FUNCTION    msg_q_next_lane
+
+DESCRIPTION
+   Called with list_mutex held, to pick the lane the next message is to be
+   received from. The high priority lane goes first, unless high_burst
+   high priority messages in a row have been received while normal
+   priority ones are waiting, in which case one normal priority message
+   goes first so that the normal lane is never starved.
+
+   p_msg_q: Message queue that is not empty.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   List to receive the next message from.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void* msg_q_next_lane(msg_q* p_msg_q)
+{
+   if( linked_list_empty(p_msg_q->high_list) )
+   {
+      p_msg_q->high_run = 0;
+      return p_msg_q->msg_list;
+   }
+
+   if( !linked_list_empty(p_msg_q->msg_list) )
+   {
+      if( p_msg_q->high_burst != 0 && p_msg_q->high_run >= p_msg_q->high_burst )
+      {
+         p_msg_q->high_run = 0;
+         p_msg_q->stats.starvation_yields++;
+         return p_msg_q->msg_list;
+      }
+      p_msg_q->high_run++;
+   }
+
+   return p_msg_q->high_list;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_snd_internal
+
+DESCRIPTION
+   Common implementation of the msg_q_snd variants.
+
+   prio:      lane to send the message to.
+   supersede: drop the pending message of the same non-zero key in the
+              same lane, if any.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at msg_q_snd.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_q_snd_internal(void* msg_q_data, void* msg_obj,
+                                         void (*dealloc)(void*), uint32_t key,
+                                         msg_q_prio_type prio, int supersede)
+{
+   msq_q_err_type rv;
+   msq_q_err_type room_rv = eMSG_Q_SUCCESS;
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+   if( msg_obj == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+   void* lane = (prio == eMSG_Q_PRIO_HIGH) ? p_msg_q->high_list : p_msg_q->msg_list;
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   LOC_LOGV("%s: Sending message with handle = 0x%08X\n", __FUNCTION__, msg_obj);
+
+   if( p_msg_q->unblocked )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   if( supersede && key != LINKED_LIST_NO_KEY &&
+       linked_list_remove_keyed(lane, key, NULL) == eLINKED_LIST_SUCCESS )
+   {
+      p_msg_q->stats.size--;
+      p_msg_q->stats.superseded++;
+      room_rv = eMSG_Q_SUPERSEDED;
+   }
+   else if( p_msg_q->stats.capacity != 0 && p_msg_q->stats.size >= p_msg_q->stats.capacity )
+   {
+      room_rv = msg_q_make_room(p_msg_q, lane, key);
+      if( room_rv == eMSG_Q_UNAVAILABLE_RESOURCE )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         pthread_mutex_unlock(&p_msg_q->list_mutex);
+         return room_rv;
+      }
+   }
+
+   rv = convert_linked_list_err_type(linked_list_add_keyed(lane, msg_obj, dealloc, key));
+   if( rv == eMSG_Q_SUCCESS )
+   {
+      rv = room_rv;
+      p_msg_q->stats.size++;
+      if( prio == eMSG_Q_PRIO_HIGH )
+      {
+         p_msg_q->stats.high_msgs++;
+      }
+      if( p_msg_q->stats.size > p_msg_q->stats.high_water )
+      {
+         p_msg_q->stats.high_water = p_msg_q->stats.size;
+         /* only report every power of 2 from MSG_Q_HIGH_WATER_REPORT_MIN on,
+            and hitting the capacity */
+         if( rv == eMSG_Q_SUCCESS &&
+             ((p_msg_q->stats.high_water >= MSG_Q_HIGH_WATER_REPORT_MIN &&
+               (p_msg_q->stats.high_water & (p_msg_q->stats.high_water - 1)) == 0) ||
+              p_msg_q->stats.high_water == p_msg_q->stats.capacity) )
+         {
+            rv = eMSG_Q_HIGH_WATER_MARK;
+         }
+      }
+   }
+
+   /* Show data is in the message queue. */
+   pthread_cond_signal(&p_msg_q->list_cond);
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   LOC_LOGV("%s: Finished Sending message with handle = 0x%08X\n", __FUNCTION__, msg_obj);
+
+   return rv;
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -90,6 +361,17 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
 
   ===========================================================================*/
 msq_q_err_type msg_q_init(void** msg_q_data)
+{
+   return msg_q_init_bounded(msg_q_data, 0, eMSG_Q_FULL_BLOCK);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_init_bounded
+
+  ===========================================================================*/
+msq_q_err_type msg_q_init_bounded(void** msg_q_data, uint32_t capacity,
+                                  msg_q_full_policy_type policy)
 {
    if( msg_q_data == NULL )
    {
@@ -112,10 +394,19 @@ msq_q_err_type msg_q_init(void** msg_q_data)
       return eMSG_Q_FAILURE_GENERAL;
    }
 
+   if( linked_list_init(&tmp_msg_q->high_list) != 0 )
+   {
+      LOC_LOGE("%s: Unable to initialize high priority storage list!\n", __FUNCTION__);
+      linked_list_destroy(&tmp_msg_q->msg_list);
+      free(tmp_msg_q);
+      return eMSG_Q_FAILURE_GENERAL;
+   }
+
    if( pthread_mutex_init(&tmp_msg_q->list_mutex, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize list mutex!\n", __FUNCTION__);
       linked_list_destroy(&tmp_msg_q->msg_list);
+      linked_list_destroy(&tmp_msg_q->high_list);
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
@@ -124,12 +415,29 @@ msq_q_err_type msg_q_init(void** msg_q_data)
    {
       LOC_LOGE("%s: Unable to initialize msg q cond var!\n", __FUNCTION__);
       linked_list_destroy(&tmp_msg_q->msg_list);
+      linked_list_destroy(&tmp_msg_q->high_list);
+      pthread_mutex_destroy(&tmp_msg_q->list_mutex);
+      free(tmp_msg_q);
+      return eMSG_Q_FAILURE_GENERAL;
+   }
+
+   if( pthread_cond_init(&tmp_msg_q->space_cond, NULL) != 0 )
+   {
+      LOC_LOGE("%s: Unable to initialize msg q space cond var!\n", __FUNCTION__);
+      linked_list_destroy(&tmp_msg_q->msg_list);
+      linked_list_destroy(&tmp_msg_q->high_list);
+      pthread_cond_destroy(&tmp_msg_q->list_cond);
       pthread_mutex_destroy(&tmp_msg_q->list_mutex);
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
    tmp_msg_q->unblocked = 0;
+   tmp_msg_q->policy = policy;
+   tmp_msg_q->has_reader = 0;
+   tmp_msg_q->high_burst = MSG_Q_HIGH_BURST_DEFAULT;
+   tmp_msg_q->high_run = 0;
+   tmp_msg_q->stats.capacity = capacity;
 
    *msg_q_data = tmp_msg_q;
 
@@ -166,8 +474,10 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
    msg_q* p_msg_q = (msg_q*)*msg_q_data;
 
    linked_list_destroy(&p_msg_q->msg_list);
+   linked_list_destroy(&p_msg_q->high_list);
    pthread_mutex_destroy(&p_msg_q->list_mutex);
    pthread_cond_destroy(&p_msg_q->list_cond);
+   pthread_cond_destroy(&p_msg_q->space_cond);
 
    p_msg_q->unblocked = 0;
 
@@ -183,6 +493,49 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
   ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*))
+{
+   return msg_q_snd_keyed(msg_q_data, msg_obj, dealloc, LINKED_LIST_NO_KEY);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_snd_keyed
+
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_keyed(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                               uint32_t key)
+{
+   return msg_q_snd_internal(msg_q_data, msg_obj, dealloc, key, eMSG_Q_PRIO_NORMAL, 0);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_snd_superseding
+
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_superseding(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                                     uint32_t key)
+{
+   return msg_q_snd_internal(msg_q_data, msg_obj, dealloc, key, eMSG_Q_PRIO_NORMAL, 1);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_snd_prio
+
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              uint32_t key, msg_q_prio_type prio, int supersede)
+{
+   return msg_q_snd_internal(msg_q_data, msg_obj, dealloc, key, prio, supersede);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_rcv
+
+  ===========================================================================*/
+msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
 {
    msq_q_err_type rv;
    if( msg_q_data == NULL )
@@ -190,6 +543,7 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_HANDLE;
    }
+
    if( msg_obj == NULL )
    {
       LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
@@ -198,8 +552,9 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
+   LOC_LOGV("%s: Waiting on message\n", __FUNCTION__);
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
-   LOC_LOGV("%s: Sending message with handle = 0x%08X\n", __FUNCTION__, msg_obj);
 
    if( p_msg_q->unblocked )
    {
@@ -208,41 +563,51 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
-   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list, msg_obj, dealloc));
+   /* Wait for data in the message queue */
+   while( msg_q_is_empty(p_msg_q) && !p_msg_q->unblocked )
+   {
+      pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
+   }
+
+   p_msg_q->reader = pthread_self();
+   p_msg_q->has_reader = 1;
 
-   /* Show data is in the message queue. */
-   pthread_cond_signal(&p_msg_q->list_cond);
+   rv = convert_linked_list_err_type(linked_list_remove(msg_q_next_lane(p_msg_q), msg_obj));
+   if( rv == eMSG_Q_SUCCESS )
+   {
+      p_msg_q->stats.size--;
+      msg_q_room_made(p_msg_q);
+   }
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
-   LOC_LOGV("%s: Finished Sending message with handle = 0x%08X\n", __FUNCTION__, msg_obj);
+   LOC_LOGV("%s: Received message 0x%08X rv = %d\n", __FUNCTION__, *msg_obj, rv);
 
    return rv;
 }
 
 /*===========================================================================
 
-  FUNCTION:   msg_q_rcv
+  FUNCTION:   msg_q_rcv_all
 
   ===========================================================================*/
-msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
+msq_q_err_type msg_q_rcv_all(void* msg_q_data, void** msg_list)
 {
-   msq_q_err_type rv;
    if( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_HANDLE;
    }
 
-   if( msg_obj == NULL )
+   if( msg_list == NULL || *msg_list == NULL || linked_list_empty(*msg_list) != 1 )
    {
-      LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
+      LOC_LOGE("%s: Invalid msg_list parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_PARAMETER;
    }
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
-   LOC_LOGV("%s: Waiting on message\n", __FUNCTION__);
+   LOC_LOGV("%s: Waiting on messages\n", __FUNCTION__);
 
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
@@ -253,19 +618,86 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
+   p_msg_q->reader = pthread_self();
+   p_msg_q->has_reader = 1;
+
    /* Wait for data in the message queue */
-   while( linked_list_empty(p_msg_q->msg_list) && !p_msg_q->unblocked )
+   while( msg_q_is_empty(p_msg_q) && !p_msg_q->unblocked )
    {
       pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
+   if( p_msg_q->unblocked )
+   {
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   /* Hand out all the pending messages, high priority ones first */
+   linked_list_splice(*msg_list, p_msg_q->high_list);
+   linked_list_splice(*msg_list, p_msg_q->msg_list);
+   p_msg_q->high_run = 0;
+
+   p_msg_q->stats.rcv_all_calls++;
+   p_msg_q->stats.rcv_all_msgs += p_msg_q->stats.size;
+   p_msg_q->stats.size = 0;
+   msg_q_room_made(p_msg_q);
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
-   LOC_LOGV("%s: Received message 0x%08X rv = %d\n", __FUNCTION__, *msg_obj, rv);
+   LOC_LOGV("%s: Received message list %p\n", __FUNCTION__, *msg_list);
 
-   return rv;
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_set_high_burst
+
+  ===========================================================================*/
+msq_q_err_type msg_q_set_high_burst(void* msg_q_data, uint32_t high_burst)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   p_msg_q->high_burst = high_burst;
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_get_stats
+
+  ===========================================================================*/
+msq_q_err_type msg_q_get_stats(void* msg_q_data, msg_q_stats_type* stats)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( stats == NULL )
+   {
+      LOC_LOGE("%s: Invalid stats parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   *stats = p_msg_q->stats;
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   return eMSG_Q_SUCCESS;
 }
 
 /*===========================================================================
@@ -288,8 +720,11 @@ msq_q_err_type msg_q_flush(void* msg_q_data)
 
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
-   /* Remove all elements from the list */
+   /* Remove all elements from the lists */
+   linked_list_flush(p_msg_q->high_list);
    rv = convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list));
+   p_msg_q->stats.size = 0;
+   msg_q_room_made(p_msg_q);
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -327,6 +762,7 @@ msq_q_err_type msg_q_unblock(void* msg_q_data)
 
    /* Allow all the waiters to wake up */
    pthread_cond_broadcast(&p_msg_q->list_cond);
+   pthread_cond_broadcast(&p_msg_q->space_cond);
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
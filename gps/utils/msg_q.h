@@ -34,6 +34,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <stdlib.h>
+#include <stdint.h>
 
 /** Linked List Return Codes */
 typedef enum
@@ -50,8 +51,69 @@ typedef enum
      /**< Failed because an there were not enough resources. */
   eMSG_Q_INSUFFICIENT_BUFFER                 = -5,
      /**< Failed because an the supplied buffer was too small. */
+  eMSG_Q_HIGH_WATER_MARK                     = 1,
+     /**< Request was successful, and the queue reached a new high water mark. */
+  eMSG_Q_DROPPED_OLDEST                      = 2,
+     /**< Request was successful, the oldest keyed message was dropped to make room. */
+  eMSG_Q_COALESCED                           = 3,
+     /**< Request was successful, the oldest message of the same key was dropped. */
+  eMSG_Q_SUPERSEDED                          = 4,
+     /**< Request was successful, the pending message of the same key was dropped. */
 }msq_q_err_type;
 
+/** What msg_q_snd does when a bounded message queue is full */
+typedef enum
+{
+  eMSG_Q_FULL_BLOCK                          = 0,
+     /**< Sender waits until there is room. The receiving thread itself is
+          never blocked, it can always send beyond the capacity. */
+  eMSG_Q_FULL_DROP_OLDEST                    = 1,
+     /**< The oldest message sent with a key, whatever the key, is
+          deallocated to make room. If there is none, the sender waits as
+          eMSG_Q_FULL_BLOCK. */
+  eMSG_Q_FULL_COALESCE                       = 2,
+     /**< The oldest message sent with the same key is deallocated to make
+          room. If there is none, the sender waits as eMSG_Q_FULL_BLOCK. */
+}msg_q_full_policy_type;
+
+/** Lanes of a message queue */
+typedef enum
+{
+  eMSG_Q_PRIO_NORMAL                         = 0,
+     /**< Lane msg_q_snd, msg_q_snd_keyed and msg_q_snd_superseding send to. */
+  eMSG_Q_PRIO_HIGH                           = 1,
+     /**< Received ahead of normal priority messages, but see
+          msg_q_set_high_burst. */
+}msg_q_prio_type;
+
+/** Message Queue Statistics */
+typedef struct
+{
+  uint32_t size;
+     /**< Number of messages currently in the queue. */
+  uint32_t capacity;
+     /**< Maximum number of messages in the queue; 0 if unbounded. */
+  uint32_t high_water;
+     /**< Largest number of messages that has been in the queue. */
+  uint64_t blocked;
+     /**< Number of times a sender had to wait for room. */
+  uint64_t dropped;
+     /**< Number of messages dropped by eMSG_Q_FULL_DROP_OLDEST. */
+  uint64_t coalesced;
+     /**< Number of messages dropped by eMSG_Q_FULL_COALESCE. */
+  uint64_t superseded;
+     /**< Number of messages dropped by msg_q_snd_superseding. */
+  uint64_t high_msgs;
+     /**< Number of messages sent with eMSG_Q_PRIO_HIGH. */
+  uint64_t starvation_yields;
+     /**< Number of times a normal priority message was received ahead of
+          pending high priority ones, after a high burst. */
+  uint64_t rcv_all_calls;
+     /**< Number of non empty batches taken by msg_q_rcv_all. */
+  uint64_t rcv_all_msgs;
+     /**< Number of messages taken by msg_q_rcv_all. */
+}msg_q_stats_type;
+
 /*===========================================================================
 FUNCTION    msg_q_init
 
@@ -90,6 +152,30 @@ SIDE EFFECTS
 ===========================================================================*/
 const void* msg_q_init2();
 
+/*===========================================================================
+FUNCTION    msg_q_init_bounded
+
+DESCRIPTION
+   Initializes internal structures for a message queue that holds at most
+   capacity messages.
+
+   msg_q_data: pointer to an opaque Q handle to be returned; NULL if fails
+   capacity:   maximum number of messages in the queue; 0 for unbounded.
+   policy:     what msg_q_snd does when the queue is full.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_init_bounded(void** msg_q_data, uint32_t capacity,
+                                  msg_q_full_policy_type policy);
+
 /*===========================================================================
 FUNCTION    msg_q_destroy
 
@@ -127,7 +213,8 @@ DEPENDENCIES
    N/A
 
 RETURN VALUE
-   Look at error codes above.
+   Look at error codes above. Positive codes are successful sends, that
+   also report a new high water mark; or a message dropped to make room.
 
 SIDE EFFECTS
    N/A
@@ -135,12 +222,122 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*));
 
+/*===========================================================================
+FUNCTION    msg_q_snd_keyed
+
+DESCRIPTION
+   Same as msg_q_snd, except that the message is tagged with a key. When a
+   bounded queue with eMSG_Q_FULL_COALESCE policy is full, the oldest
+   message of the same key is dropped in favour of this one.
+
+   msg_q_data: Message Queue to add the element to.
+   msgp:       Pointer to data to add into message queue.
+   dealloc:    Function used to deallocate memory for this element. Pass NULL
+               if you do not want data deallocated during a flush operation
+   key:        Kind of the message. 0 if it must never be dropped.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at msg_q_snd.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_keyed(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                               uint32_t key);
+
+/*===========================================================================
+FUNCTION    msg_q_snd_superseding
+
+DESCRIPTION
+   Same as msg_q_snd_keyed, except that a message of the same non-zero key
+   still pending in the queue is dropped in favour of this one, whether or
+   not the queue is full. The new message goes to the end of the queue, so
+   it is still received after the messages sent before it.
+
+   msg_q_data: Message Queue to add the element to.
+   msgp:       Pointer to data to add into message queue.
+   dealloc:    Function used to deallocate memory for this element. Pass NULL
+               if you do not want data deallocated during a flush operation
+   key:        Kind of the message. 0 if it must never be dropped.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at msg_q_snd. eMSG_Q_SUPERSEDED if a pending message was dropped.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_superseding(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                                     uint32_t key);
+
+/*===========================================================================
+FUNCTION    msg_q_snd_prio
+
+DESCRIPTION
+   Same as msg_q_snd_keyed, or msg_q_snd_superseding if supersede is
+   non-zero, except that the message is sent to the lane of the given
+   priority. Messages are received in the order they were sent within a
+   lane. Superseding and coalescing only drop messages in the same lane,
+   and eMSG_Q_FULL_DROP_OLDEST never drops high priority messages.
+
+   msg_q_data: Message Queue to add the element to.
+   msgp:       Pointer to data to add into message queue.
+   dealloc:    Function used to deallocate memory for this element. Pass NULL
+               if you do not want data deallocated during a flush operation
+   key:        Kind of the message. 0 if it must never be dropped.
+   prio:       Lane to send the message to.
+   supersede:  Drop the pending message of the same non-zero key, if any.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at msg_q_snd.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              uint32_t key, msg_q_prio_type prio, int supersede);
+
+/*===========================================================================
+FUNCTION    msg_q_set_high_burst
+
+DESCRIPTION
+   Sets how many high priority messages msg_q_rcv returns in a row, while
+   normal priority messages are waiting, before it returns one normal
+   priority message so that the normal lane is never starved. Default is 8.
+
+   msg_q_data: Message Queue to configure.
+   high_burst: Max high priority messages in a row; 0 for strict priority.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_set_high_burst(void* msg_q_data, uint32_t high_burst);
+
 /*===========================================================================
 FUNCTION    msg_q_rcv
 
 DESCRIPTION
    Retrieves data from the message queue. msg_obj is the oldest message received
-   and pointer is simply removed from message queue.
+   and pointer is simply removed from message queue. The oldest high priority
+   message goes ahead of normal priority ones, per msg_q_set_high_burst.
 
    msg_q_data: Message Queue to copy data from into msgp.
    msg_obj:    Pointer to space to copy msg_q contents to.
@@ -157,6 +354,57 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj);
 
+/*===========================================================================
+FUNCTION    msg_q_rcv_all
+
+DESCRIPTION
+   Retrieves all the data from the message queue at once. Blocks until there
+   is at least one message in the queue. All the pending messages are moved
+   to the empty list passed in under a single lock, without any allocation,
+   high priority ones ahead of normal priority ones.
+
+   msg_q_data: Message Queue to take data from.
+   msg_list:   In  - handle of an empty list from linked_list_init().
+               Out - same list, with all the messages that were in the
+                     queue. Messages are to be taken out in the order
+                     above with linked_list_remove(). The list can
+                     be passed in again once it is empty; or be released
+                     with linked_list_destroy(), which also deallocates any
+                     messages left.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_rcv_all(void* msg_q_data, void** msg_list);
+
+/*===========================================================================
+FUNCTION    msg_q_get_stats
+
+DESCRIPTION
+   Takes a snapshot of the message queue statistics.
+
+   msg_q_data: Message Queue to get statistics of.
+   stats:      Pointer to space to copy statistics to.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_get_stats(void* msg_q_data, msg_q_stats_type* stats);
+
 /*===========================================================================
 FUNCTION    msg_q_flush
 
@@ -55,6 +55,20 @@
 #define ALOGD(format, x...) TS_PRINTF("D/%s (%d): " format , LOG_TAG, getpid(), ##x)
 #define ALOGV(format, x...) TS_PRINTF("V/%s (%d): " format , LOG_TAG, getpid(), ##x)
 
+#define ANDROID_LOG_VERBOSE 2
+#define ANDROID_LOG_DEBUG   3
+#define ANDROID_LOG_INFO    4
+#define ANDROID_LOG_WARN    5
+#define ANDROID_LOG_ERROR   6
+#define __android_log_print(prio, tag, format, x...) \
+    TS_PRINTF("%d/%s (%d): " format , prio, tag, getpid(), ##x)
+#define __android_log_vprint(prio, tag, format, ap)  \
+{                                                    \
+  fprintf(stdout, "%d/%s (%d): ", prio, tag, getpid()); \
+  vfprintf(stdout, format, ap);                      \
+  fputc('\n', stdout);                               \
+}
+
 #define GETTID_PLATFORM_LIB_ABSTRACTION (syscall(SYS_gettid))
 
 #define LOC_EXT_CREATE_THREAD_CB_PLATFORM_LIB_ABSTRACTION createPthread